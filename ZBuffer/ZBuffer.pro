@@ -1,14 +1,10 @@
 SOURCES += \
-  lib/tiny_obj_loader.cc \
   src/MainWindow.cpp \
   src/ZBWidget.cpp \
-  src/Model.cpp \
   src/main.cc
 
-HEADERS += lib/Logger.hpp \
-    lib/tiny_obj_loader.h \
+HEADERS += \
         src/MainWindow.hpp \
-        src/Model.hpp \
         src/ZBWidget.hpp \
 
 FORMS += src/MainWindow.ui  \
@@ -21,6 +17,7 @@ DEPENDPATH += lib/ \
   ../QGLViewer/ \
   ../
 
+include(zbuffer_core.pri)
 
 
 OBJECTS_DIR = build/
@@ -0,0 +1,25 @@
+#include "CLocale.hpp"
+
+#include <locale.h>
+#include <stdlib.h>
+#ifdef __APPLE__
+#include <xlocale.h>
+#endif
+
+#ifdef _WIN32
+
+double strtod_c(const char *s, char **end)
+{
+  static const _locale_t locale = _create_locale(LC_NUMERIC, "C");
+  return _strtod_l(s, end, locale);
+}
+
+#else
+
+double strtod_c(const char *s, char **end)
+{
+  static const locale_t locale = newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
+  return strtod_l(s, end, locale);
+}
+
+#endif
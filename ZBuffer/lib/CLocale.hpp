@@ -0,0 +1,12 @@
+#ifndef __C_LOCALE_HPP__
+#define __C_LOCALE_HPP__
+
+/** \brief strtod() in the "C" locale, whatever setlocale() the application
+ * made.
+ *
+ * QApplication sets the user's locale on Unix, where the decimal point may
+ * be a comma; model files always use a point.
+ */
+double strtod_c(const char *s, char **end);
+
+#endif //__C_LOCALE_HPP__
@@ -4,6 +4,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 /// Utilities
 ///
@@ -12,13 +19,199 @@
 #define STR(X) #X
 #define XSTR(X) STR(X)
 
+/// Compile-time level filtering
+///
+/// Messages above LOG_LEVEL are compiled out entirely, arguments included.
+/// Assertions are controlled by NDEBUG only.
+#define LOG_LEVEL_OFF  0
+#define LOG_LEVEL_WARN 1
+#define LOG_LEVEL_INFO 2
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+/// Private function for log redirection
+//#define LOG_REDIRECT "log.txt"
+inline FILE * _get_log_file_() {
+#ifdef LOG_REDIRECT
+  static FILE * fp = fopen(LOG_REDIRECT,"a+");
+  if (fp) return fp; else return stderr;
+#else
+  return stderr;
+#endif
+}
+
+/// Private asynchronous backend
+///
+/// Callers format their record into a slot of a lock-free bounded ring
+/// buffer (Vyukov's MPMC queue, drained by one consumer) and return; a
+/// background thread writes the records out. When the ring is full the
+/// record is dropped and counted instead of blocking the caller. Once
+/// exit() starts or an assertion fails, records are written synchronously.
+/// An idle backend sleeps on a condition variable; a caller only takes its
+/// mutex to wake it, when it found the thread asleep.
+class _LogBackend_ {
+public:
+  static const size_t RECORD_SIZE = 256;
+  static const size_t CAPACITY = 4096;    // power of two
+
+  static _LogBackend_ &instance() {
+    // never destroyed: threads may still log while statics are torn down
+    static _LogBackend_ *backend = new _LogBackend_();
+    return *backend;
+  }
+
+  void write(const char *fmt, va_list args) {
+    if (m_stopped.load(std::memory_order_acquire)) {
+      vfprintf(_get_log_file_(), fmt, args);
+      fflush(_get_log_file_());
+      return;
+    }
+    size_t pos = m_enqueue.load(std::memory_order_relaxed);
+    Cell *cell;
+    for (;;) {
+      cell = &m_cells[pos & (CAPACITY-1)];
+      size_t seq = cell->seq.load(std::memory_order_acquire);
+      ptrdiff_t diff = (ptrdiff_t)seq - (ptrdiff_t)pos;
+      if (diff == 0) {
+        if (m_enqueue.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      } else {
+        pos = m_enqueue.load(std::memory_order_relaxed);
+      }
+    }
+    int n = vsnprintf(cell->text, RECORD_SIZE, fmt, args);
+    if (n >= (int)RECORD_SIZE) {            // keep the newline of truncated records
+      cell->text[RECORD_SIZE-2] = '\n';
+    }
+    cell->seq.store(pos+1, std::memory_order_release);
+    // pairs with the fence in run(): either the backend sees the record
+    // before sleeping or this sees it asleep
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_sleeping.load(std::memory_order_relaxed)) wake();
+  }
+
+  /// Write out everything queued so far; with stop, also end the thread
+  /// and switch to synchronous output.
+  void flush(bool stop) {
+    if (stop) {
+      if (m_stopped.exchange(true)) return;
+      m_quit.store(true);
+      wake();
+      if (m_thread.joinable()) m_thread.join();
+      drain();
+    } else {
+      size_t target = m_enqueue.load();
+      while (m_dequeue.load() < target && !m_stopped.load())
+        std::this_thread::yield();
+    }
+    fflush(_get_log_file_());
+  }
+
+private:
+  struct Cell {
+    std::atomic<size_t> seq;
+    char text[RECORD_SIZE];
+  };
+
+  _LogBackend_()
+    : m_enqueue(0), m_dequeue(0), m_dropped(0), m_quit(false), m_stopped(false),
+      m_sleeping(false), m_wake(false) {
+    for (size_t i = 0; i < CAPACITY; i++) m_cells[i].seq.store(i);
+    m_thread = std::thread(&_LogBackend_::run, this);
+    atexit(&_LogBackend_::stopAtExit);
+  }
+
+  static void stopAtExit() { instance().flush(true); }
+
+  // single consumer: the background thread, or the caller of flush(true)
+  // after the thread has been joined
+  bool drain() {
+    bool any = false;
+    FILE *log = _get_log_file_();
+    for (;;) {
+      size_t pos = m_dequeue.load(std::memory_order_relaxed);
+      Cell *cell = &m_cells[pos & (CAPACITY-1)];
+      if (cell->seq.load(std::memory_order_acquire) != pos+1) break;
+      fputs(cell->text, log);
+      cell->seq.store(pos+CAPACITY, std::memory_order_release);
+      m_dequeue.store(pos+1, std::memory_order_release);
+      any = true;
+    }
+    size_t dropped = m_dropped.exchange(0);
+    if (dropped) fprintf(log, "[WARN] logger: dropped %lu records\n", (unsigned long)dropped);
+    if (any || dropped) fflush(log);
+    return any;
+  }
+
+  bool pending() const {
+    size_t pos = m_dequeue.load(std::memory_order_relaxed);
+    return m_cells[pos & (CAPACITY-1)].seq.load(std::memory_order_acquire) == pos+1;
+  }
+
+  void wake() {
+    std::lock_guard<std::mutex> lock(m_sleepMutex);
+    m_wake = true;
+    m_sleepCond.notify_one();
+  }
+
+  void run() {
+    while (!m_quit.load()) {
+      if (drain()) continue;
+      std::unique_lock<std::mutex> lock(m_sleepMutex);
+      m_sleeping.store(true, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (!pending() && !m_quit.load())
+        m_sleepCond.wait(lock, [this] { return m_wake; });
+      m_wake = false;
+      m_sleeping.store(false, std::memory_order_relaxed);
+    }
+  }
+
+  Cell m_cells[CAPACITY];
+  std::atomic<size_t> m_enqueue;
+  std::atomic<size_t> m_dequeue;
+  std::atomic<size_t> m_dropped;
+  std::atomic<bool> m_quit;
+  std::atomic<bool> m_stopped;
+  std::atomic<bool> m_sleeping;   // the backend waits on m_sleepCond
+  bool m_wake;                    // guarded by m_sleepMutex
+  std::mutex m_sleepMutex;
+  std::condition_variable m_sleepCond;
+  std::thread m_thread;
+};
+
+#if defined(__GNUC__)
+__attribute__((format(printf, 1, 2)))
+#endif
+inline void _log_write_(const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  _LogBackend_::instance().write(fmt, args);
+  va_end(args);
+}
+
+/// True at most once per interval_ms for a given call-site clock.
+inline bool _log_rate_ok_(std::atomic<long long> &last, long long interval_ms) {
+  long long now = std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+  long long prev = last.load(std::memory_order_relaxed);
+  return (prev == 0 || now - prev >= interval_ms)
+      && last.compare_exchange_strong(prev, now, std::memory_order_relaxed);
+}
+
 /// Private macro for assertions
 ///
-/// Use NDEBUG to disable assertions.
+/// Use NDEBUG to disable assertions. Failures flush the queued records
+/// first so the failure is the last line of the log.
 #ifndef NDEBUG
 #define _ASSERT_(x,log,msg,...) \
   do{if(!(x)){ \
-    fprintf((log),"[FAIL] " __FILE__ ":%d " STR(x) "\n",__LINE__); \
+    _LogBackend_::instance().flush(true); \
+    fprintf((log),"[FAIL] " __FILE__ ":%d %s\n",__LINE__,STR(x)); \
     if(strcmp((msg),"")){fprintf((log),"[FAIL] " msg "\n",##__VA_ARGS__);} \
     fflush((log)); \
     exit(EXIT_FAILURE); \
@@ -28,27 +221,37 @@
 #endif
 
 /// Private macro for messages
-#define _MSG_(type,log,msg,...) \
+#define _MSG_(type,msg,...) \
   do{ \
-    fprintf((log),"[" type "] " msg "\n",##__VA_ARGS__); \
-    fflush((log)); \
+    _log_write_("[" type "] " msg "\n",##__VA_ARGS__); \
   }while(0)
 
-/// Private function for log redirection
-//#define LOG_REDIRECT "log.txt"
-static inline FILE * _get_log_file_() {
-#ifdef LOG_REDIRECT
-  static FILE * fp = fopen(LOG_REDIRECT,"a+");
-  if (fp) return fp; else return stderr;
-#else
-  return stderr;
-#endif
-}
+/// Private macro for rate-limited messages: at most one per interval_ms
+/// from the same call site.
+#define _MSG_RATE_(interval_ms,type,msg,...) \
+  do{ \
+    static std::atomic<long long> _log_last_(0); \
+    if(_log_rate_ok_(_log_last_,(interval_ms))){_MSG_(type,msg,##__VA_ARGS__);} \
+  }while(0)
 
 /// Public macros
 #define ASSERT(x) do{_ASSERT_(x,_get_log_file_(),"");}while(0)
 #define ASSERT_MSG(x,msg,...) do{_ASSERT_(x,_get_log_file_(),msg,##__VA_ARGS__);}while(0)
-#define WARN(msg,...) do{_MSG_("WARN",_get_log_file_(),msg,##__VA_ARGS__);}while(0)
-#define INFO(msg,...) do{_MSG_("INFO",_get_log_file_(),msg,##__VA_ARGS__);}while(0)
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define WARN(msg,...) _MSG_("WARN",msg,##__VA_ARGS__)
+#define WARN_EVERY(interval_ms,msg,...) _MSG_RATE_(interval_ms,"WARN",msg,##__VA_ARGS__)
+#else
+#define WARN(msg,...) do{}while(0)
+#define WARN_EVERY(interval_ms,msg,...) do{}while(0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define INFO(msg,...) _MSG_("INFO",msg,##__VA_ARGS__)
+#define INFO_EVERY(interval_ms,msg,...) _MSG_RATE_(interval_ms,"INFO",msg,##__VA_ARGS__)
+#else
+#define INFO(msg,...) do{}while(0)
+#define INFO_EVERY(interval_ms,msg,...) do{}while(0)
+#endif
+/// Write out queued messages now, e.g. before handing the log to a user.
+#define LOG_FLUSH() do{_LogBackend_::instance().flush(false);}while(0)
 
 #endif //__LOGGER_HPP__
@@ -0,0 +1,123 @@
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char EMPTY[1] = { 0 };
+
+MappedFile::MappedFile()
+  : m_data(0),
+    m_size(0),
+#ifdef _WIN32
+    m_file(INVALID_HANDLE_VALUE),
+    m_mapping(0)
+#else
+    m_fd(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+  close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const char *filename)
+{
+  close();
+  m_file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+  if ( m_file == INVALID_HANDLE_VALUE )
+    return false;
+
+  LARGE_INTEGER size;
+  if ( !GetFileSizeEx(m_file, &size) )
+  {
+    close();
+    return false;
+  }
+  m_size = size_t(size.QuadPart);
+  if ( m_size == 0 )
+  {
+    m_data = EMPTY;
+    return true;
+  }
+
+  m_mapping = CreateFileMappingA(m_file, 0, PAGE_READONLY, 0, 0, 0);
+  if ( m_mapping )
+    m_data = (const char*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+  if ( !m_data )
+  {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void MappedFile::close()
+{
+  if ( m_data && m_data != EMPTY )
+    UnmapViewOfFile(m_data);
+  if ( m_mapping )
+    CloseHandle(m_mapping);
+  if ( m_file != INVALID_HANDLE_VALUE )
+    CloseHandle(m_file);
+  m_data = 0;
+  m_size = 0;
+  m_mapping = 0;
+  m_file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::open(const char *filename)
+{
+  close();
+  m_fd = ::open(filename, O_RDONLY);
+  if ( m_fd < 0 )
+    return false;
+
+  struct stat st;
+  if ( fstat(m_fd, &st) != 0 )
+  {
+    close();
+    return false;
+  }
+  m_size = size_t(st.st_size);
+  if ( m_size == 0 )
+  {
+    m_data = EMPTY;
+    return true;
+  }
+
+  void *data = mmap(0, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+  if ( data == MAP_FAILED )
+  {
+    close();
+    return false;
+  }
+  madvise(data, m_size, MADV_SEQUENTIAL);
+  m_data = (const char*)data;
+  return true;
+}
+
+void MappedFile::close()
+{
+  if ( m_data && m_data != EMPTY )
+    munmap((void*)m_data, m_size);
+  if ( m_fd >= 0 )
+    ::close(m_fd);
+  m_data = 0;
+  m_size = 0;
+  m_fd = -1;
+}
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef __MAPPED_FILE_HPP__
+#define __MAPPED_FILE_HPP__
+
+#include <stddef.h>
+
+/** \brief Read-only memory mapping of a whole file.
+ *
+ * The contents are not NUL-terminated; parsers must stop at data()+size().
+ * An empty file maps to a valid empty range.
+ */
+class MappedFile {
+public:
+  MappedFile();
+  ~MappedFile();
+
+public:
+  /// \return false if the file cannot be opened or mapped
+  bool open(const char *filename);
+  void close();
+
+  bool isOpen() const { return m_data != 0; }
+  const char *data() const { return m_data; }
+  size_t size() const { return m_size; }
+
+private:
+  MappedFile(const MappedFile &);
+  MappedFile &operator=(const MappedFile &);
+
+private:
+  const char *m_data;
+  size_t m_size;
+#ifdef _WIN32
+  void *m_file;
+  void *m_mapping;
+#else
+  int m_fd;
+#endif
+
+};
+
+#endif //__MAPPED_FILE_HPP__
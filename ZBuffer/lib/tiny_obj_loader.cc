@@ -20,14 +20,18 @@
 #include <cstdlib>
 #include <cstring>
 #include <cassert>
+#include <stdint.h>
 
 #include <string>
 #include <vector>
 #include <map>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
 
 #include "tiny_obj_loader.h"
+#include "MappedFile.hpp"
+#include "CLocale.hpp"
 
 namespace tinyobj {
 
@@ -38,14 +42,9 @@ struct vertex_index {
   vertex_index(int vidx, int vtidx, int vnidx) : v_idx(vidx), vt_idx(vtidx), vn_idx(vnidx) {}
 
 };
-// for std::map
-static inline bool operator < (const vertex_index& a, const vertex_index& b)
+static inline bool operator == (const vertex_index& a, const vertex_index& b)
 {
-  if (a.v_idx != b.v_idx) return (a.v_idx < b.v_idx);
-  if (a.vn_idx != b.vn_idx) return (a.vn_idx < b.vn_idx);
-  if (a.vt_idx != b.vt_idx) return (a.vt_idx < b.vt_idx);
-
-  return false;
+  return a.v_idx == b.v_idx && a.vt_idx == b.vt_idx && a.vn_idx == b.vn_idx;
 }
 
 struct obj_shape {
@@ -54,6 +53,33 @@ struct obj_shape {
   std::vector<float> vt;
 };
 
+// Faces in one flat corner array: face f has the corners
+// [offsets[f], offsets[f+1]).
+struct obj_faces {
+  std::vector<vertex_index> corners;
+  std::vector<unsigned int> offsets;
+
+  obj_faces() : offsets(1, 0) {}
+  size_t size() const { return offsets.size() - 1; }
+  void endFace() { offsets.push_back(corners.size()); }
+  void clear() { corners.clear(); offsets.resize(1); }
+};
+
+// Faces [first, last) of an obj_faces.
+struct face_range {
+  const obj_faces* faces;
+  size_t first, last;
+};
+
+// The faces of a shape, possibly spread over several obj_faces.
+typedef std::vector<face_range> face_group;
+
+static inline face_group allFaces(const obj_faces& faces)
+{
+  face_range range = { &faces, 0, faces.size() };
+  return face_group(1, range);
+}
+
 static inline bool isSpace(const char c) {
   return (c == ' ') || (c == '\t');
 }
@@ -91,7 +117,7 @@ static inline std::string parseString(const char*& token)
 static inline float parseFloat(const char*& token)
 {
   token += strspn(token, " \t");
-  float f = (float)atof(token);
+  float f = (float)strtod_c(token, NULL);
   token += strcspn(token, " \t\r");
   return f;
 }
@@ -152,9 +178,86 @@ static vertex_index parseTriple(
     return vi; 
 }
 
+// Output vertex of each distinct vertex_index of a face group.
+//
+// An open addressing hash table with linear probing, sized once for the
+// group's corners. When the texcoord and normal indices of the group are
+// a function of the position index (absent, or equal to it, on every
+// corner) and the group is not much smaller than the vertex array, a
+// direct array indexed by v_idx is used instead.
+class vertex_cache {
+ public:
+  static const unsigned int kNone = ~0u;
+
+  vertex_cache(const face_group& faceGroup, size_t num_positions) {
+    size_t corners = 0;
+    bool direct = true;
+    int vt_mode = 0;  // 0 unknown, 1 absent, 2 equal to v_idx
+    int vn_mode = 0;
+    for (size_t r = 0; r < faceGroup.size(); r++) {
+      const obj_faces& faces = *faceGroup[r].faces;
+      const size_t first = faces.offsets[faceGroup[r].first];
+      const size_t last = faces.offsets[faceGroup[r].last];
+      corners += last - first;
+      for (size_t k = first; direct && k < last; k++) {
+        const vertex_index& i = faces.corners[k];
+        direct = i.v_idx >= 0 && size_t(i.v_idx) < num_positions &&
+                 sameMode(vt_mode, i.vt_idx, i.v_idx) &&
+                 sameMode(vn_mode, i.vn_idx, i.v_idx);
+      }
+    }
+
+    if (direct && corners * 4 >= num_positions) {
+      mask_ = 0;
+      values_.assign(num_positions, kNone);
+      return;
+    }
+
+    size_t capacity = 16;
+    while (capacity < 2 * corners) capacity *= 2;
+    mask_ = capacity - 1;
+    keys_.resize(capacity);
+    values_.assign(capacity, kNone);
+  }
+
+  // Slot of i, holding kNone until it is assigned.
+  unsigned int& operator [] (const vertex_index& i) {
+    if (keys_.empty()) {
+      return values_[i.v_idx];
+    }
+
+    size_t h = hash(i) & mask_;
+    while (values_[h] != kNone && !(keys_[h] == i)) {
+      h = (h + 1) & mask_;
+    }
+    keys_[h] = i;
+    return values_[h];
+  }
+
+ private:
+  static inline bool sameMode(int& mode, int idx, int v_idx) {
+    int m = (idx < 0) ? 1 : (idx == v_idx) ? 2 : 3;
+    if (mode == 0) mode = m;
+    return m != 3 && m == mode;
+  }
+
+  static inline size_t hash(const vertex_index& i) {
+    uint32_t h = uint32_t(i.v_idx) * 0x9E3779B1u;
+    h ^= uint32_t(i.vt_idx) * 0x85EBCA77u;
+    h ^= uint32_t(i.vn_idx) * 0xC2B2AE3Du;
+    return h ^ (h >> 15);
+  }
+
+  std::vector<vertex_index> keys_;
+  std::vector<unsigned int> values_;
+  size_t mask_;
+};
+
+const unsigned int vertex_cache::kNone;
+
 static unsigned int
 updateVertex(
-  std::map<vertex_index, unsigned int>& vertexCache,
+  vertex_cache& vertexCache,
   std::vector<float>& positions,
   std::vector<float>& normals,
   std::vector<float>& texcoords,
@@ -163,11 +266,11 @@ updateVertex(
   const std::vector<float>& in_texcoords,
   const vertex_index& i)
 {
-  const std::map<vertex_index, unsigned int>::iterator it = vertexCache.find(i);
+  unsigned int& cached = vertexCache[i];
 
-  if (it != vertexCache.end()) {
+  if (cached != vertex_cache::kNone) {
     // found cache
-    return it->second;
+    return cached;
   }
 
   assert(in_positions.size() > (3*i.v_idx+2));
@@ -188,7 +291,7 @@ updateVertex(
   }
 
   unsigned int idx = positions.size() / 3 - 1;
-  vertexCache[i] = idx;
+  cached = idx;
 
   return idx;
 }
@@ -199,11 +302,22 @@ exportFaceGroupToShape(
   const std::vector<float> &in_positions,
   const std::vector<float> &in_normals,
   const std::vector<float> &in_texcoords,
-  const std::vector<std::vector<vertex_index> >& faceGroup,
+  const face_group& faceGroup,
   const material_t &material,
   const std::string &name)
 {
-  if (faceGroup.empty()) {
+  // Count triangles and corners to size the output once.
+  size_t numFaces = 0, triangles = 0, corners = 0;
+  for (size_t r = 0; r < faceGroup.size(); r++) {
+    const obj_faces& faces = *faceGroup[r].faces;
+    numFaces += faceGroup[r].last - faceGroup[r].first;
+    for (size_t f = faceGroup[r].first; f < faceGroup[r].last; f++) {
+      const size_t npolys = faces.offsets[f+1] - faces.offsets[f];
+      corners += npolys;
+      triangles += (npolys > 2) ? npolys - 2 : 0;
+    }
+  }
+  if (numFaces == 0) {
     return false;
   }
 
@@ -211,33 +325,43 @@ exportFaceGroupToShape(
   std::vector<float> positions;
   std::vector<float> normals;
   std::vector<float> texcoords;
-  std::map<vertex_index, unsigned int> vertexCache;
+  vertex_cache vertexCache(faceGroup, in_positions.size() / 3);
   std::vector<unsigned int> indices;
 
-  // Flatten vertices and indices
-  for (size_t i = 0; i < faceGroup.size(); i++) {
-    const std::vector<vertex_index>& face = faceGroup[i];
+  // at most one output vertex per corner, and per input vertex if unique
+  const size_t vertices = std::min(corners, std::max(in_positions.size() / 3,
+                                   std::max(in_normals.size() / 3, in_texcoords.size() / 2)));
+  positions.reserve(3 * vertices);
+  indices.reserve(3 * triangles);
 
-    vertex_index i0 = face[0];
-    vertex_index i1(-1);
-    vertex_index i2 = face[1];
+  // Flatten vertices and indices
+  for (size_t r = 0; r < faceGroup.size(); r++) {
+    const obj_faces& faces = *faceGroup[r].faces;
+    for (size_t f = faceGroup[r].first; f < faceGroup[r].last; f++) {
+      const vertex_index* face = faces.corners.data() + faces.offsets[f];
+      const size_t npolys = faces.offsets[f+1] - faces.offsets[f];
+      if (npolys < 3) {
+        continue;
+      }
 
-    size_t npolys = face.size();
+      vertex_index i0 = face[0];
+      vertex_index i1(-1);
+      vertex_index i2 = face[1];
 
-    // Polygon -> triangle fan conversion
-    for (size_t k = 2; k < npolys; k++) {
-      i1 = i2;
-      i2 = face[k];
+      // Polygon -> triangle fan conversion
+      for (size_t k = 2; k < npolys; k++) {
+        i1 = i2;
+        i2 = face[k];
 
-      unsigned int v0 = updateVertex(vertexCache, positions, normals, texcoords, in_positions, in_normals, in_texcoords, i0);
-      unsigned int v1 = updateVertex(vertexCache, positions, normals, texcoords, in_positions, in_normals, in_texcoords, i1);
-      unsigned int v2 = updateVertex(vertexCache, positions, normals, texcoords, in_positions, in_normals, in_texcoords, i2);
+        unsigned int v0 = updateVertex(vertexCache, positions, normals, texcoords, in_positions, in_normals, in_texcoords, i0);
+        unsigned int v1 = updateVertex(vertexCache, positions, normals, texcoords, in_positions, in_normals, in_texcoords, i1);
+        unsigned int v2 = updateVertex(vertexCache, positions, normals, texcoords, in_positions, in_normals, in_texcoords, i2);
 
-      indices.push_back(v0);  // index of this vertex in positions array
-      indices.push_back(v1);
-      indices.push_back(v2);
+        indices.push_back(v0);  // index of this vertex in positions array
+        indices.push_back(v1);
+        indices.push_back(v2);
+      }
     }
-
   }
 
   //
@@ -458,7 +582,7 @@ std::string LoadMtl (
 }
 
 std::string
-LoadObj(
+LoadObjStream(
   std::vector<shape_t>& shapes,
   const char* filename,
   const char* mtl_basepath)
@@ -477,7 +601,7 @@ LoadObj(
   std::vector<float> v;          // vertices
   std::vector<float> vn;         // normals
   std::vector<float> vt;         // texture vertices
-  std::vector<std::vector<vertex_index> > faceGroup;
+  obj_faces faces;
   std::string name;
 
   // material
@@ -552,15 +676,14 @@ LoadObj(
       token += 2;
       token += strspn(token, " \t");
 
-      std::vector<vertex_index> face;
       while (!isNewLine(token[0])) {
         vertex_index vi = parseTriple(token, v.size() / 3, vn.size() / 3, vt.size() / 2);
-        face.push_back(vi);
+        faces.corners.push_back(vi);
         int n = strspn(token, " \t\r");
         token += n;
       }
 
-      faceGroup.push_back(face);
+      faces.endFace();
       
       continue;
     }
@@ -590,7 +713,7 @@ LoadObj(
 
   /*    std::string err_mtl = LoadMtl(material_map, namebuf, mtl_basepath);
       if (!err_mtl.empty()) {
-        faceGroup.clear();  // for safety
+        faces.clear();  // for safety
         return err_mtl;
       }  */
       continue;
@@ -601,12 +724,12 @@ LoadObj(
 
       // flush previous face group.
       shape_t shape;
-      bool ret = exportFaceGroupToShape(shape, v, vn, vt, faceGroup, material, name);
+      bool ret = exportFaceGroupToShape(shape, v, vn, vt, allFaces(faces), material, name);
       if (ret) {
         shapes.push_back(shape);
       }
 
-      faceGroup.clear();
+      faces.clear();
 
       std::vector<std::string> names;
       while (!isNewLine(token[0])) {
@@ -632,12 +755,12 @@ LoadObj(
 
       // flush previous face group.
       shape_t shape;
-      bool ret = exportFaceGroupToShape(shape, v, vn, vt, faceGroup, material, name);
+      bool ret = exportFaceGroupToShape(shape, v, vn, vt, allFaces(faces), material, name);
       if (ret) {
         shapes.push_back(shape);
       }
 
-      faceGroup.clear();
+      faces.clear();
 
       // @todo { multiple object name? }
       char namebuf[4096];
@@ -653,14 +776,535 @@ LoadObj(
   }
 
   shape_t shape;
-  bool ret = exportFaceGroupToShape(shape, v, vn, vt, faceGroup, material, name);
+  bool ret = exportFaceGroupToShape(shape, v, vn, vt, allFaces(faces), material, name);
   if (ret) {                            // face group not empty
     shapes.push_back(shape);
   }
-  faceGroup.clear();  // for safety
+  faces.clear();  // for safety
+
+  return err.str();
+}
+
+
+//
+// In-place parsing of a memory mapped file. Tokens are bounded by the end
+// of their line instead of a NUL terminator, nothing is copied per line,
+// and numbers are parsed without consulting the C locale.
+//
+
+static inline const char* skipSpace(const char* p, const char* end)
+{
+  while (p < end && isSpace(*p)) p++;
+  return p;
+}
+
+// end of the token at p: next space, tab or '\r'
+static inline const char* skipToken(const char* p, const char* end)
+{
+  while (p < end && !isSpace(*p) && *p != '\r') p++;
+  return p;
+}
+
+// true if the line at token starts with the n characters of cmd and a space
+static inline bool isCommand(const char* token, const char* end, const char* cmd, size_t n)
+{
+  return size_t(end - token) > n && 0 == memcmp(token, cmd, n) && isSpace(token[n]);
+}
+
+static inline bool isDigit(const char c) {
+  return (c >= '0') && (c <= '9');
+}
+
+// Powers of ten that are exact in a double.
+static const double kPow10[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Same value as (float)atof() in the "C" locale: decimal numbers with at
+// most 2^53 as significand and a power of ten up to 22 take one exactly
+// rounded double operation (Clinger's fast path); anything else, e.g.
+// 17 digit exports, "inf" or hex, falls back to strtod_c.
+static inline float parseFloatFast(const char*& token, const char* end)
+{
+  token = skipSpace(token, end);
+  const char* tokenEnd = skipToken(token, end);
+  const char* p = token;
+
+  bool negative = false;
+  if (p < tokenEnd && (*p == '+' || *p == '-')) {
+    negative = (*p == '-');
+    p++;
+  }
+
+  uint64_t mantissa = 0;
+  int digits = 0;         // significant digits in mantissa
+  int exponent = 0;
+  bool any = false;
+  while (p < tokenEnd && isDigit(*p)) {
+    any = true;
+    if (digits < 19) {
+      mantissa = mantissa * 10 + (*p - '0');
+      if (mantissa) digits++;
+    } else {
+      exponent++;
+    }
+    p++;
+  }
+  if (p < tokenEnd && *p == '.') {
+    p++;
+    while (p < tokenEnd && isDigit(*p)) {
+      any = true;
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        if (mantissa) digits++;
+        exponent--;
+      }
+      p++;
+    }
+  }
+  if (any && p < tokenEnd && (*p == 'e' || *p == 'E')) {
+    const char* q = p + 1;
+    bool negativeExponent = false;
+    if (q < tokenEnd && (*q == '+' || *q == '-')) {
+      negativeExponent = (*q == '-');
+      q++;
+    }
+    if (q < tokenEnd && isDigit(*q)) {
+      int e = 0;
+      while (q < tokenEnd && isDigit(*q)) {
+        if (e < 100000) e = e * 10 + (*q - '0');
+        q++;
+      }
+      exponent += negativeExponent ? -e : e;
+    }
+  }
+
+  const bool hex = (p < tokenEnd && (*p == 'x' || *p == 'X'));
+  double value;
+  if (any && !hex && mantissa == 0) {
+    token = tokenEnd;
+    return negative ? -0.0f : 0.0f;
+  } else if (any && !hex && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+    value = double(mantissa);
+    value = (exponent < 0) ? value / kPow10[-exponent] : value * kPow10[exponent];
+  } else {
+    char buf[64];
+    size_t n = std::min(sizeof(buf) - 1, size_t(tokenEnd - token));
+    memcpy(buf, token, n);
+    buf[n] = '\0';
+    token = tokenEnd;
+    return (float)strtod_c(buf, NULL);
+  }
+
+  token = tokenEnd;
+  return (float)(negative ? -value : value);
+}
+
+// atoi() of the digits at p, without moving p
+static inline int parseIntFast(const char* p, const char* end)
+{
+  while (p < end && (isSpace(*p) || *p == '\r')) p++;
+  bool negative = false;
+  if (p < end && (*p == '+' || *p == '-')) {
+    negative = (*p == '-');
+    p++;
+  }
+  int value = 0;
+  while (p < end && isDigit(*p)) {
+    value = value * 10 + (*p - '0');
+    p++;
+  }
+  return negative ? -value : value;
+}
+
+// next '/', space, tab or '\r'
+static inline const char* skipIndex(const char* p, const char* end)
+{
+  while (p < end && *p != '/' && !isSpace(*p) && *p != '\r') p++;
+  return p;
+}
+
+// first whitespace separated word at token, like sscanf("%s")
+static inline std::string parseName(const char* token, const char* end)
+{
+  while (token < end && (isSpace(*token) || *token == '\r' || *token == '\v' || *token == '\f')) token++;
+  const char* e = token;
+  while (e < end && !(isSpace(*e) || *e == '\r' || *e == '\v' || *e == '\f')) e++;
+  return std::string(token, e);
+}
+
+// parseTriple() on a bounded line
+static vertex_index parseTripleFast(
+  const char* &token,
+  const char* end,
+  int vsize,
+  int vnsize,
+  int vtsize)
+{
+    vertex_index vi(-1);
+
+    vi.v_idx = fixIndex(parseIntFast(token, end), vsize);
+    token = skipIndex(token, end);
+    if (token == end || token[0] != '/') {
+      return vi;
+    }
+    token++;
+
+    // i//k
+    if (token < end && token[0] == '/') {
+      token++;
+      vi.vn_idx = fixIndex(parseIntFast(token, end), vnsize);
+      token = skipIndex(token, end);
+      return vi;
+    }
+
+    // i/j/k or i/j
+    vi.vt_idx = fixIndex(parseIntFast(token, end), vtsize);
+    token = skipIndex(token, end);
+    if (token == end || token[0] != '/') {
+      return vi;
+    }
+
+    // i/j/k
+    token++;  // skip '/'
+    vi.vn_idx = fixIndex(parseIntFast(token, end), vnsize);
+    token = skipIndex(token, end);
+    return vi;
+}
+
+// A 'g', 'o' or 'usemtl' record, applied after the first 'face' faces of
+// its chunk.
+struct obj_group_event {
+  enum Type { Group, Material };
+  size_t face;
+  Type type;
+  std::string name;
+};
+
+// Records of a newline aligned range of the file. The chunk's vertices
+// go straight to their place in the file wide arrays; its faces stay in
+// the chunk and are triangulated from there.
+struct obj_chunk {
+  const char* begin;
+  const char* end;
+  size_t numV, numVn, numVt, numF;  // records, from the pre-scan
+  size_t vBase, vnBase, vtBase;     // records in the chunks before
+  obj_faces faces;
+  std::vector<obj_group_event> events;
+};
+
+// Chunks smaller than this are not worth a task.
+static const size_t kChunkSize = 256 * 1024;
+
+enum obj_record { RecordV, RecordVn, RecordVt, RecordF, RecordOther };
+
+static inline obj_record recordType(const char* token, const char* end)
+{
+  if (isCommand(token, end, "v", 1)) return RecordV;
+  if (isCommand(token, end, "vn", 2)) return RecordVn;
+  if (isCommand(token, end, "vt", 2)) return RecordVt;
+  if (isCommand(token, end, "f", 1)) return RecordF;
+  return RecordOther;
+}
+
+// Count the vertex and face records of a chunk, without parsing them.
+static void countChunk(obj_chunk& chunk)
+{
+  size_t counts[RecordOther + 1] = { 0 };
+  const char* p = chunk.begin;
+  while (p < chunk.end) {
+    const char* lineEnd = (const char*)memchr(p, '\n', chunk.end - p);
+    if (!lineEnd) lineEnd = chunk.end;
+    counts[recordType(skipSpace(p, lineEnd), lineEnd)]++;
+    p = (lineEnd < chunk.end) ? lineEnd + 1 : chunk.end;
+  }
+  chunk.numV = counts[RecordV];
+  chunk.numVn = counts[RecordVn];
+  chunk.numVt = counts[RecordVt];
+  chunk.numF = counts[RecordF];
+}
+
+// Split at the first line start after every kChunkSize bytes.
+static void splitChunks(
+  const char* fileBegin,
+  const char* fileEnd,
+  std::vector<obj_chunk>& chunks)
+{
+  for (const char* begin = fileBegin; begin < fileEnd; ) {
+    const char* end = fileEnd;
+    if (size_t(fileEnd - begin) > kChunkSize) {
+      end = (const char*)memchr(begin + kChunkSize, '\n', fileEnd - begin - kChunkSize);
+      end = end ? end + 1 : fileEnd;
+    }
+    chunks.push_back(obj_chunk());
+    chunks.back().begin = begin;
+    chunks.back().end = end;
+    begin = end;
+  }
+}
+
+// Parse a chunk; v, vn and vt are already sized for the whole file.
+static void parseChunk(
+  obj_chunk& chunk,
+  std::vector<float>& v,
+  std::vector<float>& vn,
+  std::vector<float>& vt)
+{
+  float* pv = v.data() + 3 * chunk.vBase;
+  float* pvn = vn.data() + 3 * chunk.vnBase;
+  float* pvt = vt.data() + 2 * chunk.vtBase;
+
+  // triangles, unless the pre-scan says otherwise
+  chunk.faces.offsets.reserve(chunk.numF + 1);
+  chunk.faces.corners.reserve(3 * chunk.numF);
+
+  const char* p = chunk.begin;
+  const char* const chunkEnd = chunk.end;
+  while (p < chunkEnd) {
+    const char* lineEnd = (const char*)memchr(p, '\n', chunkEnd - p);
+    if (!lineEnd) lineEnd = chunkEnd;
+
+    // Skip leading space.
+    const char* token = skipSpace(p, lineEnd);
+    p = (lineEnd < chunkEnd) ? lineEnd + 1 : chunkEnd;
+
+    if (token == lineEnd) continue; // empty line
+
+    if (token[0] == '#') continue;  // comment line
+
+    switch (recordType(token, lineEnd)) {
+    case RecordV:
+      token += 2;
+      *pv++ = parseFloatFast(token, lineEnd);
+      *pv++ = parseFloatFast(token, lineEnd);
+      *pv++ = parseFloatFast(token, lineEnd);
+      continue;
+
+    case RecordVn:
+      token += 3;
+      *pvn++ = parseFloatFast(token, lineEnd);
+      *pvn++ = parseFloatFast(token, lineEnd);
+      *pvn++ = parseFloatFast(token, lineEnd);
+      continue;
+
+    case RecordVt:
+      token += 3;
+      *pvt++ = parseFloatFast(token, lineEnd);
+      *pvt++ = parseFloatFast(token, lineEnd);
+      continue;
+
+    case RecordF: {
+      token += 2;
+      token = skipSpace(token, lineEnd);
+
+      // relative indices count from the vertices seen so far in the file
+      const int vsize = (pv - v.data()) / 3;
+      const int vnsize = (pvn - vn.data()) / 3;
+      const int vtsize = (pvt - vt.data()) / 2;
+      while (token < lineEnd && token[0] != '\r') {
+        chunk.faces.corners.push_back(parseTripleFast(token, lineEnd, vsize, vnsize, vtsize));
+        while (token < lineEnd && (isSpace(*token) || *token == '\r')) token++;
+      }
+      chunk.faces.endFace();
+      continue;
+    }
+
+    case RecordOther:
+      break;
+    }
+
+    // use mtl
+    if (isCommand(token, lineEnd, "usemtl", 6)) {
+      obj_group_event e = { chunk.faces.size(), obj_group_event::Material, parseName(token + 7, lineEnd) };
+      chunk.events.push_back(e);
+      continue;
+    }
+
+    // load mtl: ignored, as in LoadObjStream()
+    if (isCommand(token, lineEnd, "mtllib", 6)) {
+      continue;
+    }
+
+    // group name
+    if (isCommand(token, lineEnd, "g", 1)) {
+      // the first name after 'g'
+      const char* b = skipSpace(token + 1, lineEnd);
+      obj_group_event e = { chunk.faces.size(), obj_group_event::Group, std::string(b, skipToken(b, lineEnd)) };
+      chunk.events.push_back(e);
+      continue;
+    }
+
+    // object name
+    if (isCommand(token, lineEnd, "o", 1)) {
+      // @todo { multiple object name? }
+      obj_group_event e = { chunk.faces.size(), obj_group_event::Group, parseName(token + 2, lineEnd) };
+      chunk.events.push_back(e);
+      continue;
+    }
+
+    // Ignore unknown command.
+  }
+}
+
+static void forEachChunk(
+  std::vector<obj_chunk>& chunks,
+  const ParallelFor& parallelFor,
+  const std::function<void(obj_chunk&)>& fn)
+{
+  if (parallelFor && chunks.size() > 1) {
+    parallelFor(chunks.size(), [&](size_t begin, size_t end) {
+      for (size_t c = begin; c < end; c++) fn(chunks[c]);
+    });
+  } else {
+    for (size_t c = 0; c < chunks.size(); c++) fn(chunks[c]);
+  }
+}
+
+// Export faceGroup as the next shape and start a new group.
+static void flushFaceGroup(
+  std::vector<shape_t>& shapes,
+  const std::vector<float>& v,
+  const std::vector<float>& vn,
+  const std::vector<float>& vt,
+  face_group& faceGroup,
+  const material_t& material,
+  const std::string& name)
+{
+  shapes.push_back(shape_t());
+  if (!exportFaceGroupToShape(shapes.back(), v, vn, vt, faceGroup, material, name)) {
+    shapes.pop_back();
+  }
+  faceGroup.clear();
+}
+
+std::string
+LoadObj(
+  std::vector<shape_t>& shapes,
+  const char* filename,
+  const char* mtl_basepath,
+  const ParallelFor& parallelFor)
+{
+  (void)mtl_basepath;     // material libraries are not loaded, see LoadObjStream()
+
+  shapes.clear();
+
+  std::stringstream err;
+
+  MappedFile file;
+  if (!file.open(filename)) {
+    err << "Cannot open file [" << filename << "]" << std::endl;
+    return err.str();
+  }
+
+  std::vector<obj_chunk> chunks;
+  splitChunks(file.data(), file.data() + file.size(), chunks);
+
+  // Count the records to size the vertex arrays once and give every
+  // chunk its slice of them.
+  forEachChunk(chunks, parallelFor, countChunk);
+  size_t numV = 0, numVn = 0, numVt = 0;
+  for (size_t c = 0; c < chunks.size(); c++) {
+    chunks[c].vBase = numV;
+    chunks[c].vnBase = numVn;
+    chunks[c].vtBase = numVt;
+    numV += chunks[c].numV;
+    numVn += chunks[c].numVn;
+    numVt += chunks[c].numVt;
+  }
+
+  std::vector<float> v(3 * numV);     // vertices
+  std::vector<float> vn(3 * numVn);   // normals
+  std::vector<float> vt(2 * numVt);   // texture vertices
+  forEachChunk(chunks, parallelFor, [&](obj_chunk& chunk) {
+    parseChunk(chunk, v, vn, vt);
+  });
+
+  // Replay the group and material records in file order.
+  face_group faceGroup;
+  std::string name;
+
+  // material
+  std::map<std::string, material_t> material_map;
+  material_t material;
+  InitMaterial(material);
+
+  for (size_t c = 0; c < chunks.size(); c++) {
+    const obj_chunk& chunk = chunks[c];
+    size_t face = 0;
+    for (size_t i = 0; i < chunk.events.size(); i++) {
+      const obj_group_event& e = chunk.events[i];
+      if (face < e.face) {
+        face_range range = { &chunk.faces, face, e.face };
+        faceGroup.push_back(range);
+        face = e.face;
+      }
+
+      if (e.type == obj_group_event::Material) {
+        if (material_map.find(e.name) != material_map.end()) {
+          material = material_map[e.name];
+        } else {
+          // { error!! material not found }
+          InitMaterial(material);
+        }
+        continue;
+      }
+
+      // flush previous face group.
+      flushFaceGroup(shapes, v, vn, vt, faceGroup, material, name);
+      name = e.name;
+    }
+    if (face < chunk.faces.size()) {
+      face_range range = { &chunk.faces, face, chunk.faces.size() };
+      faceGroup.push_back(range);
+    }
+  }
+
+  flushFaceGroup(shapes, v, vn, vt, faceGroup, material, name);
 
   return err.str();
 }
 
+size_t
+CountTriangles(
+  const char* filename,
+  const ParallelFor& parallelFor)
+{
+  MappedFile file;
+  if (!file.open(filename)) {
+    return 0;
+  }
+
+  std::vector<obj_chunk> chunks;
+  splitChunks(file.data(), file.data() + file.size(), chunks);
+  std::vector<size_t> counts(chunks.size(), 0);
+  forEachChunk(chunks, parallelFor, [&](obj_chunk& chunk) {
+    size_t& count = counts[&chunk - chunks.data()];
+    const char* p = chunk.begin;
+    while (p < chunk.end) {
+      const char* lineEnd = (const char*)memchr(p, '\n', chunk.end - p);
+      if (!lineEnd) lineEnd = chunk.end;
+      const char* token = skipSpace(p, lineEnd);
+      p = (lineEnd < chunk.end) ? lineEnd + 1 : chunk.end;
+      if (recordType(token, lineEnd) != RecordF) continue;
+
+      // a face of n corners is exported as a fan of n - 2 triangles
+      size_t corners = 0;
+      token = skipSpace(token + 2, lineEnd);
+      while (token < lineEnd && token[0] != '\r') {
+        corners++;
+        while (token < lineEnd && !isSpace(*token) && *token != '\r') token++;
+        while (token < lineEnd && (isSpace(*token) || *token == '\r')) token++;
+      }
+      if (corners >= 3) count += corners - 2;
+    }
+  });
+  size_t numTriangles = 0;
+  for (size_t c = 0; c < counts.size(); c++) {
+    numTriangles += counts[c];
+  }
+  return numTriangles;
+}
+
 
 };
@@ -9,6 +9,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <functional>
 
 namespace tinyobj {
 
@@ -46,12 +47,34 @@ typedef struct
     mesh_t       mesh;
 } shape_t;
 
+/// Calls the given function on ranges [begin, end) covering [0, n), possibly
+/// concurrently, and returns when all ranges are done.
+typedef std::function<void(size_t n, const std::function<void(size_t, size_t)>&)> ParallelFor;
+
 /// Loads .obj from a file.
 /// 'shapes' will be filled with parsed shape data
 /// The function returns error string.
 /// Returns empty string when loading .obj success.
 /// 'mtl_basepath' is optional, and used for base path for .mtl file.
+/// The file is memory mapped and parsed in place. With 'parallelFor',
+/// newline aligned chunks of it are parsed concurrently; the result is the
+/// same either way.
 std::string LoadObj(
+    std::vector<shape_t>& shapes,   // [output]
+    const char* filename,
+    const char* mtl_basepath = NULL,
+    const ParallelFor& parallelFor = ParallelFor());
+
+/// Number of triangles LoadObj would produce from a .obj file, counted
+/// from the corners of its 'f' records without parsing any numbers.
+/// Returns 0 when the file cannot be read.
+size_t CountTriangles(
+    const char* filename,
+    const ParallelFor& parallelFor = ParallelFor());
+
+/// Same as LoadObj, reading the file line by line through std::ifstream.
+/// Kept as the reference the mapped parser is checked against.
+std::string LoadObjStream(
     std::vector<shape_t>& shapes,   // [output]
     const char* filename,
     const char* mtl_basepath = NULL);
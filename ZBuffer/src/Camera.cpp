@@ -0,0 +1,117 @@
+#include <cmath>
+#include "Camera.hpp"
+#include "Logger.hpp"
+#ifndef M_PI
+#define M_PI 3.14159265
+#endif
+
+Camera::Camera(float angleX, float angleY, float distance)
+  : m_angleX(angleX),
+    m_angleY(angleY),
+    m_distance(distance)
+{
+}
+
+void Camera::set(float angleX, float angleY, float distance)
+{
+  m_angleX = angleX;
+  m_angleY = angleY;
+  m_distance = distance;
+}
+
+Camera::Matrix4 Camera::transform(float aspect) const
+{
+  Matrix4 transform(Matrix4::Identity());
+  transform *= perspective(60.0f, aspect, 1.0f, 1000.0f);
+  transform *= lookAt(0.0f, 0.0f, m_distance, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+  transform *= rotateX(m_angleX);
+  transform *= rotateY(m_angleY);
+  return transform;
+}
+
+bool Camera::operator==(const Camera &other) const
+{
+  return m_angleX == other.m_angleX
+      && m_angleY == other.m_angleY
+      && m_distance == other.m_distance;
+}
+
+// https://www.scratchapixel.com/lessons/mathematics-physics-for-computer-graphics/lookat-function
+
+Camera::Matrix4 Camera::lookAt(float eye_x, float eye_y, float eye_z,
+                               float center_x, float center_y, float center_z,
+                               float up_x, float up_y, float up_z)
+{
+  Vector3 eye(eye_x, eye_y, eye_z);
+  Vector3 center(center_x, center_y, center_z);
+  Vector3 up(up_x, up_y, up_z);
+  Vector3 f = (center - eye).normalized();      // -forward
+  Vector3 s = f.cross(up).normalized();         // right
+  Vector3 u = s.cross(f).normalized();
+
+  Matrix4 result(Matrix4::Identity());
+  result(0, 0) = s.x();
+  result(0, 1) = s.y();
+  result(0, 2) = s.z();
+  result(1, 0) = u.x();
+  result(1, 1) = u.y();
+  result(1, 2) = u.z();
+  result(2, 0) = -f.x();
+  result(2, 1) = -f.y();
+  result(2, 2) = -f.z();
+  result(0, 3) = -s.dot(eye);
+  result(1, 3) = -u.dot(eye);
+  result(2, 3) = f.dot(eye);
+  return result;
+}
+
+Camera::Matrix4 Camera::perspective(float fov, float aspect, float near, float far)
+{
+  ASSERT(aspect!=0.0f);
+  ASSERT(near!=far);
+
+  // convert fov from degree to radians
+  fov *= (M_PI / 180.0f);
+
+  float tanHalfFov = std::tan(fov/2);
+
+  Matrix4 result(Matrix4::Zero());
+  result(0, 0) = 1.0f / (aspect * tanHalfFov);
+  result(1, 1) = 1.0f / tanHalfFov;
+  result(2, 2) = - (far + near) / (far - near);
+  result(3, 2) = -1.0f;
+  result(2, 3) = (-2.0f * far * near) / (far - near);
+  return result;
+}
+
+Camera::Matrix4 Camera::rotateX(float degree)
+{
+  float radians = degree * (M_PI / 180.0f);
+  float sinphi = std::sin(radians);
+  float cosphi = std::cos(radians);
+
+  Matrix4 result(Matrix4::Zero());
+  result(0, 0) = 1.0f;
+  result(1, 1) = cosphi;
+  result(1, 2) = -sinphi;
+  result(2, 1) = sinphi;
+  result(2, 2) = cosphi;
+  result(3, 3) = 1.0f;
+  return result;
+}
+
+Camera::Matrix4 Camera::rotateY(float degree)
+{
+  float radians = degree * (M_PI / 180.0f);
+  float sinphi = std::sin(radians);
+  float cosphi = std::cos(radians);
+
+  Matrix4 result(Matrix4::Zero());
+  result(0, 0) = cosphi;
+  result(0, 2) = sinphi;
+  result(1, 1) = 1.0f;
+  result(2, 0) = -sinphi;
+  result(2, 2) = cosphi;
+  result(3, 3) = 1.0f;
+  return result;
+}
@@ -0,0 +1,42 @@
+#ifndef __CAMERA_HPP__
+#define __CAMERA_HPP__
+
+#include "Model.hpp"
+
+/** \brief Orbit camera looking at the origin.
+ *
+ * The model is rotated by angleX around X, then by angleY around Y, and
+ * viewed from distance along +Z with a 60 degree perspective projection.
+ */
+class Camera : public EigenTypes {
+public:
+  Camera(float angleX=-90.0f, float angleY=0.0f, float distance=2.0f);
+
+public:
+  float angleX() const { return m_angleX; }
+  float angleY() const { return m_angleY; }
+  float distance() const { return m_distance; }
+  void set(float angleX, float angleY, float distance);
+
+  /// Model-view-projection matrix for an image of the given aspect ratio.
+  Matrix4 transform(float aspect) const;
+
+  bool operator==(const Camera &other) const;
+  bool operator!=(const Camera &other) const { return !(*this == other); }
+
+public:
+  static Matrix4 lookAt(float eye_x, float eye_y, float eye_z,
+                        float center_x, float center_y, float center_z,
+                        float up_x, float up_y, float up_z);
+  static Matrix4 perspective(float fov, float aspect, float near, float far);
+  static Matrix4 rotateX(float degree);
+  static Matrix4 rotateY(float degree);
+
+private:
+  float m_angleX;
+  float m_angleY;
+  float m_distance;
+
+};
+
+#endif //__CAMERA_HPP__
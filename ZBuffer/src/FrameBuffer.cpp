@@ -0,0 +1,29 @@
+#include <algorithm>
+#include "FrameBuffer.hpp"
+
+FrameBuffer::FrameBuffer()
+  : m_width(0),
+    m_height(0)
+{
+}
+
+FrameBuffer::FrameBuffer(int width, int height)
+  : m_width(0),
+    m_height(0)
+{
+  resize(width, height);
+}
+
+void FrameBuffer::resize(int width, int height)
+{
+  m_width = std::max(0, width);
+  m_height = std::max(0, height);
+  m_color.resize(size_t(m_width)*m_height);
+  m_depth.resize(size_t(m_width)*m_height);
+}
+
+void FrameBuffer::clear(uint32_t color, float depth)
+{
+  std::fill(m_color.begin(), m_color.end(), color);
+  std::fill(m_depth.begin(), m_depth.end(), depth);
+}
@@ -0,0 +1,41 @@
+#ifndef __FRAME_BUFFER_HPP__
+#define __FRAME_BUFFER_HPP__
+
+#include <vector>
+#include <stdint.h>
+
+/** \brief Color and depth planes of one rendered image.
+ *
+ * Colors are 0xAARRGGBB words, row 0 is the top of the image; the layout
+ * matches QImage::Format_ARGB32 so widgets can wrap it without copying.
+ */
+class FrameBuffer {
+public:
+  FrameBuffer();
+  FrameBuffer(int width, int height);
+
+public:
+  void resize(int width, int height);
+  void clear(uint32_t color, float depth=1.0f);
+
+  int width() const { return m_width; }
+  int height() const { return m_height; }
+
+  uint32_t *pixels() { return m_color.empty() ? 0 : &m_color[0]; }
+  const uint32_t *pixels() const { return m_color.empty() ? 0 : &m_color[0]; }
+  uint32_t *scanLine(int y) { return pixels() + size_t(y)*m_width; }
+  const uint32_t *scanLine(int y) const { return pixels() + size_t(y)*m_width; }
+
+  /// Depth plane, indexed bottom-up like raster coordinates: depth()[y*width+x].
+  float *depth() { return m_depth.empty() ? 0 : &m_depth[0]; }
+  const float *depth() const { return m_depth.empty() ? 0 : &m_depth[0]; }
+
+private:
+  int m_width;
+  int m_height;
+  std::vector<uint32_t> m_color;
+  std::vector<float> m_depth;
+
+};
+
+#endif //__FRAME_BUFFER_HPP__
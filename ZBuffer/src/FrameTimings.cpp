@@ -0,0 +1,55 @@
+#include <cstdio>
+#include "FrameTimings.hpp"
+
+void FrameTimings::reset()
+{
+  for ( int i=0; i < NUM_STAGES; i++ )
+    ms[i] = 0.0;
+  wallMs = 0.0;
+}
+
+double FrameTimings::total() const
+{
+  double sum = 0.0;
+  for ( int i=0; i < NUM_STAGES; i++ )
+    sum += ms[i];
+  return sum;
+}
+
+FrameTimings &FrameTimings::operator+=(const FrameTimings &other)
+{
+  for ( int i=0; i < NUM_STAGES; i++ )
+    ms[i] += other.ms[i];
+  wallMs += other.wallMs;
+  return *this;
+}
+
+FrameTimings FrameTimings::operator/(double frames) const
+{
+  FrameTimings result(*this);
+  for ( int i=0; i < NUM_STAGES; i++ )
+    result.ms[i] /= frames;
+  result.wallMs /= frames;
+  return result;
+}
+
+const char *FrameTimings::name(Stage stage)
+{
+  static const char *names[NUM_STAGES] = {
+    "clear", "transform", "setup", "raster", "depth", "shade", "present"
+  };
+  return names[stage];
+}
+
+std::string FrameTimings::toString() const
+{
+  std::string s;
+  char buf[64];
+  for ( int i=0; i < NUM_STAGES; i++ )
+  {
+    snprintf(buf, sizeof(buf), "%s %.2f ", name(Stage(i)), ms[i]);
+    s += buf;
+  }
+  snprintf(buf, sizeof(buf), "wall %.2f ms", wallMs);
+  return s + buf;
+}
@@ -0,0 +1,59 @@
+#ifndef __FRAME_TIMINGS_HPP__
+#define __FRAME_TIMINGS_HPP__
+
+#include <chrono>
+#include <string>
+
+/** \brief Time spent in each pipeline stage of one or more frames.
+ *
+ * Stages that run in parallel add up the time of every thread, so the sum
+ * of all stages may exceed the wall-clock time of the frame; wallMs holds
+ * the latter.
+ */
+struct FrameTimings {
+  enum Stage {
+    Clear,
+    Transform,    /// vertex transform and frustum cull
+    Setup,        /// triangle setup and binning into tiles
+    Raster,
+    Depth,
+    Shade,
+    Present,      /// handing the image to the display, filled in by the front end
+    NUM_STAGES
+  };
+
+  double ms[NUM_STAGES];
+  double wallMs;
+
+  FrameTimings() { reset(); }
+  void reset();
+  double total() const;
+  FrameTimings &operator+=(const FrameTimings &other);
+  FrameTimings operator/(double frames) const;
+
+  static const char *name(Stage stage);
+  /// One line "clear 0.12 transform 3.40 ... ms" for logs.
+  std::string toString() const;
+};
+
+/** \brief Adds the lifetime of the object to a millisecond counter.
+ */
+class ScopedTimer {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  explicit ScopedTimer(double &ms)
+    : m_ms(ms), m_start(Clock::now())
+  {}
+  ~ScopedTimer()
+  {
+    m_ms += std::chrono::duration<double, std::milli>(Clock::now() - m_start).count();
+  }
+
+private:
+  double &m_ms;
+  Clock::time_point m_start;
+
+};
+
+#endif //__FRAME_TIMINGS_HPP__
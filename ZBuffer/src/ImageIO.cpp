@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "ImageIO.hpp"
+
+bool ImageIO::savePPM(const char *filename, const FrameBuffer &fb)
+{
+  FILE *fp = fopen(filename, "wb");
+  if ( !fp )
+    return false;
+
+  fprintf(fp, "P6\n%d %d\n255\n", fb.width(), fb.height());
+  std::vector<unsigned char> row(3*size_t(fb.width()));
+  for ( int y=0; y < fb.height(); y++ )
+  {
+    const uint32_t *line = fb.scanLine(y);
+    for ( int x=0; x < fb.width(); x++ )
+    {
+      row[3*x]   = (unsigned char)(line[x] >> 16);
+      row[3*x+1] = (unsigned char)(line[x] >> 8);
+      row[3*x+2] = (unsigned char)(line[x]);
+    }
+    if ( !row.empty() )
+      fwrite(&row[0], 1, row.size(), fp);
+  }
+  bool ok = !ferror(fp);
+  return fclose(fp) == 0 && ok;
+}
+
+bool ImageIO::loadPPM(const char *filename, FrameBuffer &fb)
+{
+  FILE *fp = fopen(filename, "rb");
+  if ( !fp )
+    return false;
+
+  int width, height, maxval;
+  if ( fscanf(fp, "P6 %d %d %d", &width, &height, &maxval) != 3
+       || width <= 0 || height <= 0 || maxval != 255 || fgetc(fp) == EOF )
+  {
+    fclose(fp);
+    return false;
+  }
+
+  fb.resize(width, height);
+  std::vector<unsigned char> row(3*size_t(width));
+  bool ok = true;
+  for ( int y=0; y < height && ok; y++ )
+  {
+    ok = fread(&row[0], 1, row.size(), fp) == row.size();
+    uint32_t *line = fb.scanLine(y);
+    for ( int x=0; x < width && ok; x++ )
+      line[x] = 0xff000000 | row[3*x] << 16 | row[3*x+1] << 8 | row[3*x+2];
+  }
+  fclose(fp);
+  return ok;
+}
+
+static std::vector<uint32_t> make_crc_table()
+{
+  std::vector<uint32_t> table(256);
+  for ( uint32_t i=0; i < 256; i++ )
+  {
+    uint32_t c = i;
+    for ( int k=0; k < 8; k++ )
+      c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+    table[i] = c;
+  }
+  return table;
+}
+
+static uint32_t crc32(const unsigned char *data, size_t n, uint32_t crc=0)
+{
+  static const std::vector<uint32_t> table = make_crc_table();
+  crc = ~crc;
+  for ( size_t i=0; i < n; i++ )
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+static void put_u32(std::string &out, uint32_t v)
+{
+  out += char(v >> 24);
+  out += char(v >> 16);
+  out += char(v >> 8);
+  out += char(v);
+}
+
+// length, type, data and CRC of the type and data
+static void put_chunk(std::string &out, const char *type, const std::string &data)
+{
+  put_u32(out, uint32_t(data.size()));
+  std::string body = std::string(type, 4) + data;
+  out += body;
+  put_u32(out, crc32((const unsigned char*)body.data(), body.size()));
+}
+
+bool ImageIO::savePNG(const char *filename, const FrameBuffer &fb)
+{
+  const int width = fb.width();
+  const int height = fb.height();
+
+  // filter type 0 (none) followed by the RGB bytes of every row
+  std::string raw;
+  raw.reserve(size_t(height) * (1 + 3*size_t(width)));
+  for ( int y=0; y < height; y++ )
+  {
+    const uint32_t *line = fb.scanLine(y);
+    raw += char(0);
+    for ( int x=0; x < width; x++ )
+    {
+      raw += char(line[x] >> 16);
+      raw += char(line[x] >> 8);
+      raw += char(line[x]);
+    }
+  }
+
+  // zlib stream of stored deflate blocks
+  std::string zlib;
+  zlib += char(0x78);
+  zlib += char(0x01);
+  uint32_t a = 1, b = 0;                  // Adler-32
+  size_t pos = 0;
+  do
+  {
+    const size_t n = std::min<size_t>(65535, raw.size() - pos);
+    zlib += char(pos + n == raw.size() ? 1 : 0);
+    zlib += char(n);
+    zlib += char(n >> 8);
+    zlib += char(~n);
+    zlib += char(~n >> 8);
+    zlib.append(raw, pos, n);
+    for ( size_t i=pos; i < pos+n; i++ )
+    {
+      a = (a + (unsigned char)raw[i]) % 65521;
+      b = (b + a) % 65521;
+    }
+    pos += n;
+  } while ( pos < raw.size() );
+  put_u32(zlib, (b << 16) | a);
+
+  std::string header;
+  put_u32(header, uint32_t(width));
+  put_u32(header, uint32_t(height));
+  header += char(8);                      // bit depth
+  header += char(2);                      // color type RGB
+  header += std::string(3, char(0));      // deflate, adaptive filtering, no interlace
+
+  std::string png("\x89PNG\r\n\x1a\n", 8);
+  put_chunk(png, "IHDR", header);
+  put_chunk(png, "IDAT", zlib);
+  put_chunk(png, "IEND", std::string());
+
+  FILE *fp = fopen(filename, "wb");
+  if ( !fp )
+    return false;
+  bool ok = fwrite(png.data(), 1, png.size(), fp) == png.size();
+  return fclose(fp) == 0 && ok;
+}
@@ -0,0 +1,26 @@
+#ifndef __IMAGE_IO_HPP__
+#define __IMAGE_IO_HPP__
+
+#include "FrameBuffer.hpp"
+
+/** \brief Reading and writing the color plane of a FrameBuffer.
+ *
+ * Binary PPM (P6) and uncompressed RGB PNG keep the tools free of image
+ * library dependencies; alpha is dropped on writing and set to opaque on
+ * reading.
+ */
+struct ImageIO {
+  /// \return false if the file cannot be written
+  static bool savePPM(const char *filename, const FrameBuffer &fb);
+  /// \return false if the file is missing or not a binary 8-bit PPM
+  static bool loadPPM(const char *filename, FrameBuffer &fb);
+
+  /** \brief Write an 8-bit RGB PNG using stored (uncompressed) deflate
+   * blocks; larger than a compressed PNG but cheap to produce.
+   *
+   * \return false if the file cannot be written
+   */
+  static bool savePNG(const char *filename, const FrameBuffer &fb);
+};
+
+#endif //__IMAGE_IO_HPP__
@@ -1,40 +1,112 @@
 #include <QLabel>
+#include <QFileInfo>
+#include <algorithm>
 #include "MainWindow.hpp"
 #include "ui_MainWindow.h"
 #include "ZBWidget.hpp"
+#include "ThreadPool.hpp"
+#include "Trace.hpp"
+#include "Logger.hpp"
 
-MainWindow::MainWindow(std::vector<Model*> model, QWidget *parent) :
+const char *MainWindow::TRACE_FILE = "zbuffer_trace.json";
+
+MainWindow::MainWindow(const std::vector<std::string> &filenames, QWidget *parent) :
   QMainWindow(parent),
-  m_model(model),
-  m_ui(new Ui::MainWindow)
+  m_filenames(filenames),
+  m_model(filenames.size(), (Model*)0),
+  m_ui(new Ui::MainWindow),
+  m_loaded(filenames.size(), (Model*)0),
+  m_pendingLoads(0)
 {
   m_ui->setupUi(this);
-  for (int i = 0; i<3; ++i)
-  {
-      char cstr[10];
-      itoa(m_model[i]->trianglesNumber()/3,cstr,10);
-    m_ui->gridLayout->addWidget(new QLabel(cstr), 0,i, Qt::AlignCenter);
-    m_ui->gridLayout->addWidget(new ZBWidget(model[i], this), 1, i);
-  }
-  for (int i = 3; i<6; ++i)
+  for (size_t i = 0; i < filenames.size(); ++i)
   {
-    char cstr[10];
-    itoa(m_model[i]->trianglesNumber()/3,cstr,10);
-    m_ui->gridLayout->addWidget(new QLabel(cstr), 2,i-3, Qt::AlignCenter);
-    m_ui->gridLayout->addWidget(new ZBWidget(model[i], this), 3, i-3);
+    const int row = 2 * int(i / 3);
+    const int column = int(i % 3);
+    m_labels.push_back(new QLabel("loading"));
+    m_widgets.push_back(new ZBWidget(0, this));
+    m_ui->gridLayout->addWidget(m_labels[i], row, column, Qt::AlignCenter);
+    m_ui->gridLayout->addWidget(m_widgets[i], row + 1, column);
+    m_ui->gridLayout->setRowStretch(row, 0);
+    m_ui->gridLayout->setRowStretch(row + 1, 1);
   }
-  m_ui->gridLayout->setRowStretch(0, 0);
-  m_ui->gridLayout->setRowStretch(1, 1);
-  m_ui->gridLayout->setRowStretch(2, 0);
-  m_ui->gridLayout->setRowStretch(3, 1);
 
   setWindowIcon(QIcon("z-buffer-net.jpg"));
 
+  // smallest file first, so the first image shows up as early as possible
+  std::vector<size_t> order(filenames.size());
+  for (size_t i = 0; i < order.size(); ++i)
+    order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return QFileInfo(filenames[a].c_str()).size() < QFileInfo(filenames[b].c_str()).size();
+  });
+
+  m_pendingLoads = order.size();
+  for (size_t k = 0; k < order.size(); ++k)
+  {
+    const int i = int(order[k]);
+    ThreadPool::instance().submit([this, i] {
+      Model *model = new Model(m_filenames[i].c_str(), 0, Model::Lazy);
+      std::lock_guard<std::mutex> lock(m_loadMutex);
+      m_loaded[i] = model;
+      QMetaObject::invokeMethod(this, "modelLoaded", Qt::QueuedConnection, Q_ARG(int, i));
+      --m_pendingLoads;
+      m_loadCond.notify_all();
+    });
+  }
 }
 
 MainWindow::~MainWindow()
 {
-  for (int i = 0; i< 6; ++i)
-      delete m_model[i];
+  // wait for the loads still running, then free models either way
+  {
+    std::unique_lock<std::mutex> lock(m_loadMutex);
+    m_loadCond.wait(lock, [this] { return m_pendingLoads == 0; });
+  }
+  for (size_t i = 0; i < m_widgets.size(); ++i)
+    delete m_widgets[i];            // before their models
+  for (size_t i = 0; i < m_model.size(); ++i)
+  {
+    delete m_model[i];
+    delete m_loaded[i];
+  }
   delete m_ui;
 }
+
+void MainWindow::modelLoaded(int i)
+{
+  Model *model;
+  {
+    std::lock_guard<std::mutex> lock(m_loadMutex);
+    model = m_loaded[i];
+    m_loaded[i] = 0;
+  }
+  if ( !model )
+    return;
+
+  m_model[i] = model;
+  m_labels[i]->setText(QString::number(model->numTriangles()));
+  m_widgets[i]->setModel(model);
+}
+
+void MainWindow::keyPressEvent(QKeyEvent *event)
+{
+  if ( event->key() != Qt::Key_F12 || event->isAutoRepeat() )
+  {
+    QMainWindow::keyPressEvent(event);
+    return;
+  }
+  if ( !Trace::recording() )
+  {
+    Trace::start();
+    INFO("trace: recording, press F12 again to save");
+  }
+  else
+  {
+    Trace::stop();
+    if ( Trace::write(TRACE_FILE) )
+      INFO("trace: written to %s", TRACE_FILE);
+    else
+      WARN("trace: cannot write %s", TRACE_FILE);
+  }
+}
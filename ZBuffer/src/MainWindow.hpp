@@ -2,24 +2,60 @@
 #define __MAIN_WINDOW_HPP__
 
 #include <QMainWindow>
+#include <QKeyEvent>
+#include <QLabel>
+#include <condition_variable>
+#include <mutex>
 #include "Model.hpp"
 
+class ZBWidget;
+
 namespace Ui {
   class MainWindow;
 }
 
+/** \brief Grid of ZBWidgets, one per model file.
+ *
+ * The window shows up right away: the models are scanned concurrently on
+ * the ThreadPool, smallest file first, and each widget shows a placeholder
+ * until its model arrives. Models are Lazy: their geometry loads with the
+ * first frame and is evicted again, least recently rendered first, when
+ * the grid exceeds Model::memoryBudget().
+ */
 class MainWindow : public QMainWindow {
 
 Q_OBJECT
 
 public:
-  explicit MainWindow(std::vector<Model*> model, QWidget *parent=0);
+  explicit MainWindow(const std::vector<std::string> &filenames, QWidget *parent=0);
   ~MainWindow();
 
+  /// File written when a trace recording is stopped with F12.
+  static const char *TRACE_FILE;
+
+protected:
+  /** \brief F12 starts recording a Trace, the next F12 writes it to
+   * TRACE_FILE for chrome://tracing or ui.perfetto.dev.
+   */
+  virtual void keyPressEvent(QKeyEvent *event);
+
+private slots:
+  /// Hand model i, loaded on the pool, to its widget.
+  void modelLoaded(int i);
+
 private:
-  std::vector<Model *> m_model;
+  std::vector<std::string> m_filenames;
+  std::vector<Model *> m_model;     /// models handed to the widgets
+  std::vector<ZBWidget *> m_widgets;
+  std::vector<QLabel *> m_labels;
   Ui::MainWindow *m_ui;
 
+  // models loaded on the pool and not yet picked up by modelLoaded()
+  std::mutex m_loadMutex;
+  std::condition_variable m_loadCond;
+  std::vector<Model *> m_loaded;
+  size_t m_pendingLoads;
+
 };
 
 #endif //__MAIN_WINDOW_HPP__
@@ -0,0 +1,389 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include "MeshCache.hpp"
+#include "MappedFile.hpp"
+#include "Logger.hpp"
+
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char MAGIC[8] = { 'Z', 'B', 'M', 'E', 'S', 'H', '\r', '\n' };
+const uint32_t VERSION = 3;
+const size_t ALIGNMENT = 16;
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t numShapes;
+  uint32_t variant;       /// as passed to save()
+  uint32_t reserved;
+  uint64_t sourceSize;
+  int64_t sourceTime;     /// modification time of the source, in seconds
+  uint64_t sourceHash;
+  uint64_t checksum;      /// hash of everything after the header
+  uint64_t numTriangles;
+  float bounds[6];        /// min x, y, z, max x, y, z over all shapes
+};
+
+struct Block {
+  uint64_t offset;        /// from the start of the file
+  uint64_t count;         /// elements
+};
+
+struct ShapeEntry {
+  Block name;
+  Block positions;
+  Block normals;
+  Block texcoords;
+  Block indices;
+  float bounds[6];
+  uint32_t reserved[2];
+};
+
+std::string s_directory;
+bool s_enabled = false;
+std::atomic<unsigned> s_tempCounter(0);
+
+inline uint64_t rotl(uint64_t x, int r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t mix(uint64_t h, uint64_t w)
+{
+  return rotl(h ^ (w * 0xbf58476d1ce4e5b9ull), 27) * 0x94d049bb133111ebull;
+}
+
+size_t align(size_t offset)
+{
+  return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+void shape_bounds(const std::vector<float> &positions, float bounds[6])
+{
+  for ( int k=0; k < 3; k++ )
+  {
+    bounds[k] = std::numeric_limits<float>::max();
+    bounds[3+k] = -std::numeric_limits<float>::max();
+  }
+  for ( size_t i=0; i + 2 < positions.size(); i += 3 )
+    for ( int k=0; k < 3; k++ )
+    {
+      bounds[k] = std::min(bounds[k], positions[i+k]);
+      bounds[3+k] = std::max(bounds[3+k], positions[i+k]);
+    }
+}
+
+// size and modification time of a file; false if it does not exist
+bool file_status(const char *filename, uint64_t &size, int64_t &time)
+{
+  struct stat st;
+  if ( stat(filename, &st) != 0 )
+    return false;
+  size = uint64_t(st.st_size);
+  time = int64_t(st.st_mtime);
+  return true;
+}
+
+// true if count elements of size bytes at offset lie inside a file of n bytes
+bool inside(const Block &block, size_t size, size_t n)
+{
+  return block.offset <= n && block.count <= (n - block.offset) / size;
+}
+
+// write data to a temporary file and rename it, so readers never see a
+// partial cache and ones that have the old file mapped keep it; the name
+// is unique per process and call, so concurrent writers of the same cache
+// file do not truncate each other's temporary
+bool write_file(const std::string &filename, const std::vector<char> &data)
+{
+  char suffix[48];
+  sprintf(suffix, ".%ld.%u.tmp", long(getpid()), unsigned(s_tempCounter++));
+  const std::string temp = filename + suffix;
+  FILE *fp = fopen(temp.c_str(), "wb");
+  if ( !fp )
+    return false;
+  bool ok = fwrite(&data[0], 1, data.size(), fp) == data.size();
+  ok = (fclose(fp) == 0) && ok;
+#ifdef _WIN32
+  if ( ok )
+    remove(filename.c_str());
+#endif
+  if ( !ok || rename(temp.c_str(), filename.c_str()) != 0 )
+  {
+    remove(temp.c_str());
+    return false;
+  }
+  return true;
+}
+
+// true if the arrays of mesh fit together: whole vertices and triangles,
+// a normal per vertex or none, and every index naming a vertex
+bool consistent(const tinyobj::mesh_t &mesh)
+{
+  const size_t numVertices = mesh.positions.size() / 3;
+  if ( mesh.positions.size() % 3 != 0 || mesh.indices.size() % 3 != 0
+       || (!mesh.normals.empty() && mesh.normals.size() != mesh.positions.size()) )
+    return false;
+  for ( size_t i=0; i < mesh.indices.size(); i++ )
+    if ( mesh.indices[i] >= numVertices )
+      return false;
+  return true;
+}
+
+template <typename T>
+void copy_block(std::vector<T> &out, const char *data, const Block &block)
+{
+  const T *begin = reinterpret_cast<const T*>(data + block.offset);
+  out.assign(begin, begin + block.count);
+}
+
+} // namespace
+
+void MeshCache::setDirectory(const std::string &dir)
+{
+  s_directory = dir;
+}
+
+void MeshCache::setEnabled(bool enabled)
+{
+  s_enabled = enabled;
+}
+
+bool MeshCache::enabled()
+{
+  return s_enabled;
+}
+
+std::string MeshCache::path(const char *source)
+{
+  if ( s_directory.empty() )
+    return std::string(source) + ".zbmesh";
+
+  // the file name and a hash of the whole path, so equally named sources
+  // in different directories do not share a cache file
+  std::string name(source);
+  size_t slash = name.find_last_of("/\\");
+  if ( slash != std::string::npos )
+    name = name.substr(slash+1);
+  char suffix[32];
+  sprintf(suffix, "_%016llx.zbmesh", (unsigned long long)hash(source, strlen(source)));
+  return s_directory + "/" + name + suffix;
+}
+
+uint64_t MeshCache::hash(const char *data, size_t n)
+{
+  // four independent lanes over 32-byte blocks, then the tail word by word
+  uint64_t h[4] = { 0x9e3779b97f4a7c15ull ^ n, 0xc2b2ae3d27d4eb4full,
+                    0x165667b19e3779f9ull, 0x85ebca77c2b2ae63ull };
+  size_t i = 0;
+  for ( ; i + 32 <= n; i += 32 )
+    for ( int k=0; k < 4; k++ )
+    {
+      uint64_t w;
+      memcpy(&w, data + i + 8*k, 8);
+      h[k] = mix(h[k], w);
+    }
+  uint64_t result = mix(mix(mix(h[0], h[1]), h[2]), h[3]);
+  for ( ; i < n; i += 8 )
+  {
+    uint64_t w = 0;
+    memcpy(&w, data + i, std::min(size_t(8), n - i));
+    result = mix(result, w);
+  }
+  return result ^ (result >> 31);
+}
+
+bool MeshCache::load(const char *source, std::vector<tinyobj::shape_t> &shapes, uint32_t variant)
+{
+  if ( !s_enabled )
+    return false;
+
+  const std::string filename = path(source);
+  MappedFile cache;
+  uint64_t cacheSize;
+  int64_t cacheTime;
+  if ( !cache.open(filename.c_str()) || cache.size() < sizeof(Header)
+       || !file_status(filename.c_str(), cacheSize, cacheTime) )
+    return false;
+  const char *data = cache.data();
+  const size_t size = cache.size();
+
+  Header header;
+  memcpy(&header, data, sizeof(header));
+  if ( memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION
+       || header.variant != variant || header.numShapes > (size - sizeof(Header)) / sizeof(ShapeEntry) )
+    return false;
+
+  // like make, trust an unchanged size and modification time instead of
+  // hashing the whole source; a source modified in the second the cache
+  // was written could still change under the same time, so then hash it
+  uint64_t sourceSize;
+  int64_t sourceTime;
+  if ( !file_status(source, sourceSize, sourceTime) || sourceSize != header.sourceSize )
+    return false;
+  const bool hashed = sourceTime != header.sourceTime || sourceTime >= cacheTime;
+  if ( hashed )
+  {
+    MappedFile file;
+    if ( !file.open(source) || file.size() != header.sourceSize
+         || hash(file.data(), file.size()) != header.sourceHash )
+      return false;
+  }
+  if ( hash(data + sizeof(Header), size - sizeof(Header)) != header.checksum )
+  {
+    WARN("%s is damaged, rebuilding it", filename.c_str());
+    return false;
+  }
+
+  std::vector<tinyobj::shape_t> result(header.numShapes);
+  for ( size_t i=0; i < result.size(); i++ )
+  {
+    ShapeEntry entry;
+    memcpy(&entry, data + sizeof(Header) + i * sizeof(ShapeEntry), sizeof(entry));
+    if ( !inside(entry.name, 1, size) || !inside(entry.positions, sizeof(float), size)
+         || !inside(entry.normals, sizeof(float), size) || !inside(entry.texcoords, sizeof(float), size)
+         || !inside(entry.indices, sizeof(unsigned int), size) )
+      return false;
+
+    tinyobj::shape_t &shape = result[i];
+    shape.name.assign(data + entry.name.offset, size_t(entry.name.count));
+    copy_block(shape.mesh.positions, data, entry.positions);
+    copy_block(shape.mesh.normals, data, entry.normals);
+    copy_block(shape.mesh.texcoords, data, entry.texcoords);
+    copy_block(shape.mesh.indices, data, entry.indices);
+    shape.material = tinyobj::material_t();
+    // the checksum only catches damage, not a stale or edited file
+    if ( !consistent(shape.mesh) )
+    {
+      WARN("%s does not fit its source, rebuilding it", filename.c_str());
+      return false;
+    }
+  }
+  shapes.swap(result);
+
+  // the contents matched, store the new time so the next load skips the hash
+  if ( hashed )
+  {
+    std::vector<char> buffer(data, data + size);
+    header.sourceTime = sourceTime;
+    memcpy(&buffer[0], &header, sizeof(header));
+    cache.close();
+    write_file(filename, buffer);
+  }
+  return true;
+}
+
+bool MeshCache::info(const char *source, uint32_t variant, size_t &numTriangles, float bounds[6])
+{
+  if ( !s_enabled )
+    return false;
+
+  Header header;
+  FILE *fp = fopen(path(source).c_str(), "rb");
+  if ( !fp )
+    return false;
+  const bool ok = fread(&header, sizeof(header), 1, fp) == 1;
+  fclose(fp);
+  if ( !ok || memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION
+       || header.variant != variant )
+    return false;
+
+  uint64_t sourceSize;
+  int64_t sourceTime;
+  if ( !file_status(source, sourceSize, sourceTime) || sourceSize != header.sourceSize )
+    return false;
+  numTriangles = size_t(header.numTriangles);
+  memcpy(bounds, header.bounds, sizeof(header.bounds));
+  return true;
+}
+
+bool MeshCache::save(const char *source, const std::vector<tinyobj::shape_t> &shapes, uint32_t variant)
+{
+  if ( !s_enabled )
+    return false;
+
+  // the time before the contents, so an edit while hashing shows as a change
+  uint64_t sourceSize;
+  int64_t sourceTime;
+  MappedFile file;
+  if ( !file_status(source, sourceSize, sourceTime) || !file.open(source) )
+    return false;
+
+  Header header;
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.numShapes = uint32_t(shapes.size());
+  header.variant = variant;
+  header.reserved = 0;
+  header.sourceSize = file.size();
+  header.sourceTime = sourceTime;
+  header.sourceHash = hash(file.data(), file.size());
+  header.numTriangles = 0;
+
+  // lay out the blocks behind the shape table
+  std::vector<ShapeEntry> entries(shapes.size());
+  size_t offset = sizeof(Header) + shapes.size() * sizeof(ShapeEntry);
+  for ( size_t i=0; i < shapes.size(); i++ )
+  {
+    const tinyobj::mesh_t &mesh = shapes[i].mesh;
+    ShapeEntry &entry = entries[i];
+    Block *blocks[] = { &entry.name, &entry.positions, &entry.normals, &entry.texcoords, &entry.indices };
+    const size_t counts[] = { shapes[i].name.size(), mesh.positions.size(), mesh.normals.size(),
+                              mesh.texcoords.size(), mesh.indices.size() };
+    const size_t sizes[] = { 1, sizeof(float), sizeof(float), sizeof(float), sizeof(unsigned int) };
+    for ( int k=0; k < 5; k++ )
+    {
+      offset = align(offset);
+      blocks[k]->offset = offset;
+      blocks[k]->count = counts[k];
+      offset += counts[k] * sizes[k];
+    }
+    shape_bounds(mesh.positions, entry.bounds);
+    entry.reserved[0] = entry.reserved[1] = 0;
+    header.numTriangles += mesh.indices.size() / 3;
+  }
+
+  float all[6];
+  shape_bounds(std::vector<float>(), all);
+  for ( size_t i=0; i < entries.size(); i++ )
+    for ( int k=0; k < 3; k++ )
+    {
+      all[k] = std::min(all[k], entries[i].bounds[k]);
+      all[3+k] = std::max(all[3+k], entries[i].bounds[3+k]);
+    }
+  memcpy(header.bounds, all, sizeof(all));
+
+  std::vector<char> buffer(offset, 0);
+  if ( !entries.empty() )
+    memcpy(&buffer[sizeof(Header)], &entries[0], entries.size() * sizeof(ShapeEntry));
+  for ( size_t i=0; i < shapes.size(); i++ )
+  {
+    const tinyobj::mesh_t &mesh = shapes[i].mesh;
+    const ShapeEntry &entry = entries[i];
+    std::copy(shapes[i].name.begin(), shapes[i].name.end(), buffer.begin() + entry.name.offset);
+    if ( !mesh.positions.empty() )
+      memcpy(&buffer[entry.positions.offset], &mesh.positions[0], mesh.positions.size() * sizeof(float));
+    if ( !mesh.normals.empty() )
+      memcpy(&buffer[entry.normals.offset], &mesh.normals[0], mesh.normals.size() * sizeof(float));
+    if ( !mesh.texcoords.empty() )
+      memcpy(&buffer[entry.texcoords.offset], &mesh.texcoords[0], mesh.texcoords.size() * sizeof(float));
+    if ( !mesh.indices.empty() )
+      memcpy(&buffer[entry.indices.offset], &mesh.indices[0], mesh.indices.size() * sizeof(unsigned int));
+  }
+  header.checksum = hash(&buffer[0] + sizeof(Header), buffer.size() - sizeof(Header));
+  memcpy(&buffer[0], &header, sizeof(Header));
+
+  return write_file(path(source), buffer);
+}
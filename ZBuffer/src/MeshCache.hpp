@@ -0,0 +1,56 @@
+#ifndef __MESH_CACHE_HPP__
+#define __MESH_CACHE_HPP__
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "tiny_obj_loader.h"
+
+/** \brief Binary copy of loaded meshes, so every model file is parsed once.
+ *
+ * After the first load a model saves its shapes, normals included, to a
+ * cache file; later loads map that file and copy the arrays out in bulk
+ * when the source is unchanged. That is decided by its size and
+ * modification time; the source is only hashed when the time differs or
+ * is not older than the cache file. The file holds a header with the
+ * source size, time and hash, the variant, the bounds and triangle count
+ * of the model, a table with name, bounds and block offsets per shape,
+ * and the 16-byte aligned position, normal, texcoord and index blocks.
+ *
+ * Blocks use the byte order of the writer; a cache from a machine with
+ * the other byte order fails the version check and is rebuilt.
+ */
+struct MeshCache {
+  /** \brief Directory of the cache files; empty, the default, puts each
+   * one next to its source as <source>.zbmesh. Set before loading models.
+   */
+  static void setDirectory(const std::string &dir);
+  /** \brief Caching is off by default, so tools leave the model
+   * directories alone and every run parses; the application turns it on.
+   */
+  static void setEnabled(bool enabled);
+  static bool enabled();
+
+  /// Cache file of source.
+  static std::string path(const char *source);
+
+  /** \brief variant tells apart meshes processed differently after
+   * parsing, e.g. by MeshCleanup; a cache only loads for the variant it
+   * was saved with.
+   * \return false if caching is off or there is no valid cache for source
+   */
+  static bool load(const char *source, std::vector<tinyobj::shape_t> &shapes, uint32_t variant = 0);
+  /** \brief Triangle count and bounds of source from the cache header,
+   * without reading the blocks or hashing the source; only the size of
+   * the source is checked.
+   * \return false if caching is off or there is no cache of this variant
+   */
+  static bool info(const char *source, uint32_t variant, size_t &numTriangles, float bounds[6]);
+  /// \return false if caching is off or the cache cannot be written
+  static bool save(const char *source, const std::vector<tinyobj::shape_t> &shapes, uint32_t variant = 0);
+
+  /// 64-bit hash of n bytes, as stored for the source and the payload.
+  static uint64_t hash(const char *data, size_t n);
+};
+
+#endif //__MESH_CACHE_HPP__
@@ -0,0 +1,253 @@
+#include <algorithm>
+#include <cstring>
+#include <stdint.h>
+#include "MeshCleanup.hpp"
+
+namespace {
+
+const unsigned int NONE = ~0u;
+
+bool s_enabled = false;
+double s_sliverThreshold = 1e-8;
+
+inline uint32_t mix(uint32_t h, uint32_t w)
+{
+  h ^= w * 0xcc9e2d51u;
+  h = (h << 15) | (h >> 17);
+  return h * 0x1b873593u + 0xe6546b64u;
+}
+
+// bits of f with -0 folded into 0, so equal values hash equally
+inline uint32_t float_bits(float f)
+{
+  if ( f == 0.0f )
+    f = 0.0f;
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof(bits));
+  return bits;
+}
+
+size_t table_size(size_t n)
+{
+  size_t size = 16;
+  while ( size < 2*n )
+    size *= 2;
+  return size;
+}
+
+/// The attributes of a vertex, as welding compares them.
+class VertexKey {
+public:
+  explicit VertexKey(const tinyobj::mesh_t &mesh)
+    : m_mesh(mesh),
+      m_hasNormals(mesh.normals.size() == mesh.positions.size()),
+      m_hasTexcoords(mesh.texcoords.size() / 2 == mesh.positions.size() / 3)
+  {}
+
+  uint32_t hash(size_t v) const
+  {
+    uint32_t h = 0;
+    for ( int k=0; k < 3; k++ )
+      h = mix(h, float_bits(m_mesh.positions[3*v+k]));
+    if ( m_hasNormals )
+      for ( int k=0; k < 3; k++ )
+        h = mix(h, float_bits(m_mesh.normals[3*v+k]));
+    if ( m_hasTexcoords )
+      for ( int k=0; k < 2; k++ )
+        h = mix(h, float_bits(m_mesh.texcoords[2*v+k]));
+    return h ^ (h >> 16);
+  }
+
+  bool equal(size_t a, size_t b) const
+  {
+    for ( int k=0; k < 3; k++ )
+      if ( m_mesh.positions[3*a+k] != m_mesh.positions[3*b+k] )
+        return false;
+    if ( m_hasNormals )
+      for ( int k=0; k < 3; k++ )
+        if ( m_mesh.normals[3*a+k] != m_mesh.normals[3*b+k] )
+          return false;
+    if ( m_hasTexcoords )
+      for ( int k=0; k < 2; k++ )
+        if ( m_mesh.texcoords[2*a+k] != m_mesh.texcoords[2*b+k] )
+          return false;
+    return true;
+  }
+
+private:
+  const tinyobj::mesh_t &m_mesh;
+  bool m_hasNormals;
+  bool m_hasTexcoords;
+};
+
+// first vertex equal to each vertex; vertices without an earlier equal one
+// map to themselves. \return the number of vertices with an earlier one
+size_t weld_map(const tinyobj::mesh_t &mesh, std::vector<unsigned int> &first)
+{
+  const size_t numVertices = mesh.positions.size() / 3;
+  const VertexKey key(mesh);
+  std::vector<unsigned int> table(table_size(numVertices), NONE);
+  const size_t mask = table.size() - 1;
+
+  first.resize(numVertices);
+  size_t welded = 0;
+  for ( size_t v=0; v < numVertices; v++ )
+  {
+    size_t slot = key.hash(v) & mask;
+    while ( table[slot] != NONE && !key.equal(table[slot], v) )
+      slot = (slot + 1) & mask;
+    if ( table[slot] == NONE )
+      table[slot] = unsigned(v);
+    else
+      welded++;
+    first[v] = table[slot];
+  }
+  return welded;
+}
+
+enum Shape { Proper, ZeroArea, Sliver };
+
+// a triangle with a zero cross product, or one small against the fourth
+// power of its longest edge, so the test does not depend on the scale
+Shape triangle_shape(const std::vector<float> &positions, const unsigned int *t, double epsilon)
+{
+  const float *p0 = &positions[3*t[0]];
+  const float *p1 = &positions[3*t[1]];
+  const float *p2 = &positions[3*t[2]];
+  const double ax = double(p1[0]) - p0[0], ay = double(p1[1]) - p0[1], az = double(p1[2]) - p0[2];
+  const double bx = double(p2[0]) - p0[0], by = double(p2[1]) - p0[1], bz = double(p2[2]) - p0[2];
+  const double cx = ay*bz - az*by, cy = az*bx - ax*bz, cz = ax*by - ay*bx;
+  const double cross = cx*cx + cy*cy + cz*cz;
+  if ( cross == 0.0 )
+    return ZeroArea;
+  const double ex = bx - ax, ey = by - ay, ez = bz - az;
+  const double longest = std::max(std::max(ax*ax + ay*ay + az*az, bx*bx + by*by + bz*bz),
+                                  ex*ex + ey*ey + ez*ez);
+  return cross <= epsilon * longest * longest ? Sliver : Proper;
+}
+
+// the triangle rotated to start at its smallest index, equal for all
+// rotations of the same oriented triangle
+void canonical(const unsigned int *t, unsigned int out[3])
+{
+  const int r = (t[0] <= t[1] && t[0] <= t[2]) ? 0 : (t[1] <= t[2] ? 1 : 2);
+  for ( int k=0; k < 3; k++ )
+    out[k] = t[(r+k) % 3];
+}
+
+} // namespace
+
+MeshCleanup::Stats::Stats()
+  : weldedVertices(0), degenerateTriangles(0), sliverTriangles(0), duplicateTriangles(0)
+{
+}
+
+MeshCleanup::Stats &MeshCleanup::Stats::operator+=(const Stats &other)
+{
+  weldedVertices += other.weldedVertices;
+  degenerateTriangles += other.degenerateTriangles;
+  sliverTriangles += other.sliverTriangles;
+  duplicateTriangles += other.duplicateTriangles;
+  return *this;
+}
+
+bool MeshCleanup::Stats::empty() const
+{
+  return weldedVertices == 0 && degenerateTriangles == 0 && sliverTriangles == 0
+      && duplicateTriangles == 0;
+}
+
+void MeshCleanup::setEnabled(bool enabled)
+{
+  s_enabled = enabled;
+}
+
+bool MeshCleanup::enabled()
+{
+  return s_enabled;
+}
+
+void MeshCleanup::setSliverThreshold(double epsilon)
+{
+  s_sliverThreshold = epsilon;
+}
+
+double MeshCleanup::sliverThreshold()
+{
+  return s_sliverThreshold;
+}
+
+uint32_t MeshCleanup::variant()
+{
+  if ( !s_enabled )
+    return 0;
+  // meshes cleaned with different thresholds are cached apart
+  uint64_t bits;
+  memcpy(&bits, &s_sliverThreshold, sizeof(bits));
+  const uint32_t v = mix(mix(1, uint32_t(bits)), uint32_t(bits >> 32));
+  return v ? v : 1;
+}
+
+MeshCleanup::Stats MeshCleanup::run(tinyobj::mesh_t &mesh)
+{
+  Stats stats;
+  std::vector<unsigned int> &indices = mesh.indices;
+
+  // welded vertices stay in the arrays, unreferenced
+  std::vector<unsigned int> first;
+  stats.weldedVertices = weld_map(mesh, first);
+  if ( stats.weldedVertices > 0 )
+    for ( size_t i=0; i < indices.size(); i++ )
+      indices[i] = first[indices[i]];
+
+  // compact the kept triangles in place; table holds the first index of
+  // each kept triangle, in the compacted array
+  std::vector<unsigned int> table(table_size(indices.size() / 3), NONE);
+  const size_t mask = table.size() - 1;
+  size_t kept = 0;
+  for ( size_t i=0; i + 2 < indices.size(); i += 3 )
+  {
+    const unsigned int *t = &indices[i];
+    if ( t[0] == t[1] || t[1] == t[2] || t[0] == t[2] )
+    {
+      stats.degenerateTriangles++;
+      continue;
+    }
+    const Shape shape = triangle_shape(mesh.positions, t, s_sliverThreshold);
+    if ( shape != Proper )
+    {
+      if ( shape == ZeroArea )
+        stats.degenerateTriangles++;
+      else
+        stats.sliverTriangles++;
+      continue;
+    }
+
+    unsigned int c[3];
+    canonical(t, c);
+    size_t slot = mix(mix(mix(0, c[0]), c[1]), c[2]) & mask;
+    bool duplicate = false;
+    for ( ; table[slot] != NONE; slot = (slot + 1) & mask )
+    {
+      unsigned int other[3];
+      canonical(&indices[table[slot]], other);
+      if ( other[0] == c[0] && other[1] == c[1] && other[2] == c[2] )
+      {
+        duplicate = true;
+        break;
+      }
+    }
+    if ( duplicate )
+    {
+      stats.duplicateTriangles++;
+      continue;
+    }
+
+    table[slot] = unsigned(kept);
+    for ( int k=0; k < 3; k++ )
+      indices[kept+k] = t[k];
+    kept += 3;
+  }
+  indices.resize(kept);
+  return stats;
+}
@@ -0,0 +1,52 @@
+#ifndef __MESH_CLEANUP_HPP__
+#define __MESH_CLEANUP_HPP__
+
+#include <cstddef>
+#include <stdint.h>
+#include "tiny_obj_loader.h"
+
+/** \brief Optional pass over freshly loaded shapes that removes geometry
+ * no later stage can use.
+ *
+ * Welds vertices whose position, normal and texcoord are all equal, then
+ * drops triangles with a repeated vertex or a zero cross product, slivers
+ * whose squared cross product is at most the sliver threshold times the
+ * fourth power of their longest edge, and triangles that repeat an
+ * earlier one with the same orientation. A
+ * triangle and its reversed twin are both kept, they face different ways.
+ * Vertex order and the order of the kept triangles are preserved; welded
+ * vertices stay in the arrays, unreferenced.
+ */
+struct MeshCleanup {
+  /// What run() removed.
+  struct Stats {
+    size_t weldedVertices;      /// vertices replaced by an earlier equal one
+    size_t degenerateTriangles; /// repeated vertex or zero cross product
+    size_t sliverTriangles;
+    size_t duplicateTriangles;
+
+    Stats();
+    Stats &operator+=(const Stats &other);
+    bool empty() const;
+  };
+
+  /** \brief Whether Model runs the pass after parsing; off by default.
+   * Set before loading models, the MeshCache keeps cleaned and raw meshes
+   * apart.
+   */
+  static void setEnabled(bool enabled);
+  static bool enabled();
+  /** \brief Relative sliver threshold, 1e-8 by default: the squared ratio
+   * of the height over the longest edge to that edge, so 1e-8 drops
+   * triangles less than 1e-4 times as high as long. 0 keeps every
+   * triangle with a nonzero cross product.
+   */
+  static void setSliverThreshold(double epsilon);
+  static double sliverThreshold();
+  /// MeshCache variant of meshes loaded with the current settings, 0 when off.
+  static uint32_t variant();
+
+  static Stats run(tinyobj::mesh_t &mesh);
+};
+
+#endif //__MESH_CLEANUP_HPP__
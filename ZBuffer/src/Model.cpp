@@ -1,22 +1,249 @@
 #include <Eigen/Dense>
 #include "Model.hpp"
 #include "Logger.hpp"
+#include "Trace.hpp"
+#include "ThreadPool.hpp"
+#include "MeshCache.hpp"
+#include "MeshCleanup.hpp"
+#include "PlyLoader.hpp"
 #include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <limits>
+#include <cmath>
 
-Model::Model(const char *filename)
-  : m_filename(filename)
+static uint64_t next_model_version()
 {
-  std::string err = tinyobj::LoadObj(m_shapes, filename);
-  ASSERT_MSG(err.empty(), "%s", err.c_str());
+  static std::atomic<uint64_t> counter(0);
+  return ++counter;
+}
 
-  for ( size_t i=0; i < m_shapes.size(); i++ ) {
-    if ( m_shapes[i].mesh.normals.empty() )
-      calculate_normal(i);
+namespace {
+
+// Lazy models, most recently acquired first, and their budget
+std::mutex s_residencyMutex;
+std::list<Model *> s_lazyModels;
+size_t s_memoryBudget = 0;
+size_t s_residentBytes = 0;
+
+size_t geometry_bytes(const std::vector<tinyobj::shape_t> &shapes)
+{
+  size_t bytes = 0;
+  for ( size_t i=0; i < shapes.size(); i++ )
+  {
+    const tinyobj::mesh_t &mesh = shapes[i].mesh;
+    bytes += sizeof(tinyobj::shape_t)
+           + sizeof(float) * (mesh.positions.capacity() + mesh.normals.capacity() + mesh.texcoords.capacity())
+           + sizeof(unsigned int) * mesh.indices.capacity();
   }
+  return bytes;
+}
+
+} // namespace
+
+Model::Model(const char *filename, ThreadPool *pool, Loading loading)
+  : m_filename(filename),
+    m_version(next_model_version()),
+    m_pool(pool ? pool : &ThreadPool::instance()),
+    m_numTriangles(0),
+    m_hasBounds(false),
+    m_loading(loading),
+    m_resident(false),
+    m_modified(false),
+    m_pins(0),
+    m_bytes(0)
+{
+  if ( m_loading == Eager )
+  {
+    load();
+    m_resident = true;
+    return;
+  }
+
+  TraceScope trace("scan");
+  size_t numTriangles = 0;
+  float bounds[6];
+  if ( MeshCache::info(filename, MeshCleanup::variant(), numTriangles, bounds) )
+  {
+    memcpy(m_bounds, bounds, sizeof(bounds));
+    m_hasBounds = true;
+  }
+  else if ( PlyLoader::isPly(filename) )
+    numTriangles = PlyLoader::countFaces(filename);
+  else
+    numTriangles = tinyobj::CountTriangles(filename);
+  m_numTriangles = numTriangles;
+
+  std::lock_guard<std::mutex> lock(s_residencyMutex);
+  m_lruEntry = s_lazyModels.insert(s_lazyModels.end(), this);
 }
 
 Model::~Model()
 {
+  if ( m_loading == Eager )
+    return;
+  std::lock_guard<std::mutex> lock(s_residencyMutex);
+  ASSERT_MSG(m_pins == 0, "%s: destroyed while acquired", m_filename.c_str());
+  if ( m_resident )
+    s_residentBytes -= m_bytes;
+  s_lazyModels.erase(m_lruEntry);
+}
+
+void Model::load()
+{
+  TraceScope trace("load");
+  const char *filename = m_filename.c_str();
+  const uint32_t variant = MeshCleanup::variant();
+  if ( !MeshCache::load(filename, m_shapes, variant) )
+  {
+    ThreadPool *pool = m_pool;
+    tinyobj::ParallelFor parallelFor = [pool](size_t n, const std::function<void(size_t, size_t)> &fn) {
+      pool->parallelFor(n, 1, fn);
+    };
+    std::string err = PlyLoader::isPly(filename) ? PlyLoader::load(m_shapes, filename)
+                                                 : tinyobj::LoadObj(m_shapes, filename, NULL, parallelFor);
+    ASSERT_MSG(err.empty(), "%s", err.c_str());
+
+    if ( MeshCleanup::enabled() )
+    {
+      MeshCleanup::Stats stats;
+      for ( size_t i=0; i < m_shapes.size(); i++ )
+        stats += MeshCleanup::run(m_shapes[i].mesh);
+      // shapes of only degenerate faces are left without any
+      m_shapes.erase(std::remove_if(m_shapes.begin(), m_shapes.end(), [](const tinyobj::shape_t &shape) {
+        return shape.mesh.indices.empty();
+      }), m_shapes.end());
+      if ( !stats.empty() )
+        INFO("%s: welded %lu vertices, removed %lu degenerate, %lu sliver and %lu duplicate triangles",
+             filename, (unsigned long)stats.weldedVertices, (unsigned long)stats.degenerateTriangles,
+             (unsigned long)stats.sliverTriangles, (unsigned long)stats.duplicateTriangles);
+    }
+
+    for ( size_t i=0; i < m_shapes.size(); i++ ) {
+      if ( m_shapes[i].mesh.normals.empty() )
+        calculate_normal(i, *m_pool, EqualWeights);
+    }
+
+    if ( MeshCache::enabled() && !MeshCache::save(filename, m_shapes, variant) )
+      WARN("cannot write mesh cache %s", MeshCache::path(filename).c_str());
+  }
+
+  size_t numTriangles = 0;
+  float bounds[6];
+  for ( int k=0; k < 3; k++ )
+  {
+    bounds[k] = std::numeric_limits<float>::max();
+    bounds[3+k] = -std::numeric_limits<float>::max();
+  }
+  for ( size_t i=0; i < m_shapes.size(); i++ )
+  {
+    const std::vector<float> &positions = m_shapes[i].mesh.positions;
+    for ( size_t j=0; j + 2 < positions.size(); j += 3 )
+      for ( int k=0; k < 3; k++ )
+      {
+        bounds[k] = std::min(bounds[k], positions[j+k]);
+        bounds[3+k] = std::max(bounds[3+k], positions[j+k]);
+      }
+    numTriangles += m_shapes[i].mesh.indices.size() / 3;
+  }
+  m_numTriangles = numTriangles;
+
+  std::lock_guard<std::mutex> lock(s_residencyMutex);
+  memcpy(m_bounds, bounds, sizeof(bounds));
+  m_hasBounds = true;
+}
+
+void Model::acquire()
+{
+  if ( m_loading == Eager )
+    return;
+  {
+    std::lock_guard<std::mutex> lock(s_residencyMutex);
+    ++m_pins;
+    s_lazyModels.splice(s_lazyModels.begin(), s_lazyModels, m_lruEntry);
+  }
+
+  // pinned, so nothing evicts the model while it loads
+  std::lock_guard<std::mutex> loadLock(m_loadMutex);
+  if ( m_resident )
+    return;
+  load();
+  if ( m_modified )
+  {
+    // the reload dropped the recalculated normals
+    m_version = next_model_version();
+    m_modified = false;
+  }
+
+  std::lock_guard<std::mutex> lock(s_residencyMutex);
+  m_bytes = geometry_bytes(m_shapes);
+  s_residentBytes += m_bytes;
+  m_resident = true;
+  trimToBudget();
+}
+
+void Model::release()
+{
+  if ( m_loading == Eager )
+    return;
+  std::lock_guard<std::mutex> lock(s_residencyMutex);
+  ASSERT_MSG(m_pins > 0, "%s: release() without acquire()", m_filename.c_str());
+  --m_pins;
+  trimToBudget();
+}
+
+bool Model::resident() const
+{
+  return m_resident;
+}
+
+Model::Loading Model::loading() const
+{
+  return m_loading;
+}
+
+bool Model::bounds(float box[6]) const
+{
+  std::lock_guard<std::mutex> lock(s_residencyMutex);
+  if ( m_hasBounds )
+    memcpy(box, m_bounds, sizeof(m_bounds));
+  return m_hasBounds;
+}
+
+void Model::trimToBudget()
+{
+  // called with s_residencyMutex held
+  std::list<Model *>::reverse_iterator it = s_lazyModels.rbegin();
+  for ( ; s_memoryBudget > 0 && s_residentBytes > s_memoryBudget && it != s_lazyModels.rend(); ++it )
+  {
+    Model *model = *it;
+    if ( model->m_pins > 0 || !model->m_resident )
+      continue;
+    std::vector<tinyobj::shape_t>().swap(model->m_shapes);
+    s_residentBytes -= model->m_bytes;
+    model->m_bytes = 0;
+    model->m_resident = false;
+  }
+}
+
+void Model::setMemoryBudget(size_t bytes)
+{
+  std::lock_guard<std::mutex> lock(s_residencyMutex);
+  s_memoryBudget = bytes;
+  trimToBudget();
+}
+
+size_t Model::memoryBudget()
+{
+  std::lock_guard<std::mutex> lock(s_residencyMutex);
+  return s_memoryBudget;
+}
+
+size_t Model::residentBytes()
+{
+  std::lock_guard<std::mutex> lock(s_residencyMutex);
+  return s_residentBytes;
 }
 
 void Model::debug() const
@@ -39,6 +266,11 @@ void Model::debug() const
   }
 }
 
+const std::string &Model::filename() const
+{
+  return m_filename;
+}
+
 size_t Model::numShapes() const
 {
   return m_shapes.size();
@@ -82,147 +314,245 @@ void *Model::indexData(size_t i)
   return (void*)&(m_shapes[i].mesh.indices[0]);
 }
 
-void Model::calculate_normal(size_t idx)
+size_t Model::numTriangles() const
 {
-  // Index is assumed
-  ASSERT(!m_shapes[idx].mesh.indices.empty());
-
-  const std::vector<unsigned int> & indices = m_shapes[idx].mesh.indices;
-  const std::vector<float> & positions = m_shapes[idx].mesh.positions;
+  return m_numTriangles;
+}
 
-  // To store normal for each vertex
-  std::vector<Vector3> new_normals(positions.size()/3, Vector3::Zero());
+uint64_t Model::version() const
+{
+  return m_version;
+}
 
-  // For each face, calculate face normal, add it to each vertex of the face
-  for ( size_t i=0; i < indices.size(); i += 3 )
+void Model::recalculateNormals(NormalWeighting weighting)
+{
+  for ( size_t i=0; i < m_shapes.size(); i++ )
   {
-    Vector3 a(positions[3*indices[i+1]  ]-positions[3*indices[i]  ],
-                      positions[3*indices[i+1]+1]-positions[3*indices[i]+1],
-                      positions[3*indices[i+1]+2]-positions[3*indices[i]+2]);
-    Vector3 b(positions[3*indices[i+2]  ]-positions[3*indices[i]  ],
-                      positions[3*indices[i+2]+1]-positions[3*indices[i]+1],
-                      positions[3*indices[i+2]+2]-positions[3*indices[i]+2]);
-    Vector3 n = a.cross(b).normalized();
-    new_normals[indices[i  ]] += n;
-    new_normals[indices[i+1]] += n;
-    new_normals[indices[i+2]] += n;
+    if ( m_shapes[i].mesh.indices.empty() )
+      continue;
+    m_shapes[i].mesh.normals.clear();
+    calculate_normal(i, *m_pool, weighting);
   }
-  for ( size_t i=0; i < new_normals.size(); i++ )
+  m_version = next_model_version();
+  m_modified = true;
+}
+
+// faces per batch of the face normal pass; the batch is gathered into
+// lane arrays so the cross products and norms vectorize
+static const size_t FACE_BATCH = 8;
+
+// weighted normals of faces [begin, end), and with AngleWeights the angle
+// at each of their corners
+static void face_normals(const std::vector<unsigned int> &indices, const std::vector<float> &positions,
+                         size_t begin, size_t end, Model::NormalWeighting weighting,
+                         double *normals, double *angles)
+{
+  double ax[FACE_BATCH], ay[FACE_BATCH], az[FACE_BATCH];
+  double bx[FACE_BATCH], by[FACE_BATCH], bz[FACE_BATCH];
+  double cx[FACE_BATCH], cy[FACE_BATCH], cz[FACE_BATCH];
+  double len[FACE_BATCH], scale[FACE_BATCH];
+
+  for ( size_t f=begin; f < end; f += FACE_BATCH )
   {
-    new_normals[i].normalize();
+    const size_t n = std::min(FACE_BATCH, end - f);
+    for ( size_t k=0; k < n; k++ )
+    {
+      const float *p0 = &positions[3*indices[3*(f+k)  ]];
+      const float *p1 = &positions[3*indices[3*(f+k)+1]];
+      const float *p2 = &positions[3*indices[3*(f+k)+2]];
+      ax[k] = p1[0] - p0[0]; ay[k] = p1[1] - p0[1]; az[k] = p1[2] - p0[2];
+      bx[k] = p2[0] - p0[0]; by[k] = p2[1] - p0[1]; bz[k] = p2[2] - p0[2];
+    }
+    for ( size_t k=0; k < n; k++ )
+    {
+      cx[k] = ay[k]*bz[k] - az[k]*by[k];
+      cy[k] = az[k]*bx[k] - ax[k]*bz[k];
+      cz[k] = ax[k]*by[k] - ay[k]*bx[k];
+      len[k] = std::sqrt(cx[k]*cx[k] + cy[k]*cy[k] + cz[k]*cz[k]);
+      // the cross product is twice the area; degenerate faces add nothing
+      scale[k] = (weighting == Model::AreaWeights || len[k] == 0.0) ? 1.0 : 1.0 / len[k];
+    }
+    for ( size_t k=0; k < n; k++ )
+    {
+      normals[3*(f+k)  ] = cx[k] * scale[k];
+      normals[3*(f+k)+1] = cy[k] * scale[k];
+      normals[3*(f+k)+2] = cz[k] * scale[k];
+    }
+
+    if ( weighting == Model::AngleWeights )
+    {
+      // angle between the two edges at each corner; atan2 of |e1 x e2|,
+      // the same at all corners, and e1 . e2 stays accurate for slivers
+      for ( size_t k=0; k < n; k++ )
+      {
+        const double ex = bx[k] - ax[k], ey = by[k] - ay[k], ez = bz[k] - az[k];
+        angles[3*(f+k)  ] = std::atan2(len[k], ax[k]*bx[k] + ay[k]*by[k] + az[k]*bz[k]);
+        angles[3*(f+k)+1] = std::atan2(len[k], -(ax[k]*ex + ay[k]*ey + az[k]*ez));
+        angles[3*(f+k)+2] = std::atan2(len[k], bx[k]*ex + by[k]*ey + bz[k]*ez);
+      }
+    }
   }
+}
+
+void Model::calculate_normal(size_t idx, ThreadPool &pool, NormalWeighting weighting)
+{
+  // Index is assumed
+  ASSERT(!m_shapes[idx].mesh.indices.empty());
+
+  const std::vector<unsigned int> & indices = m_shapes[idx].mesh.indices;
+  const std::vector<float> & positions = m_shapes[idx].mesh.positions;
+  const size_t numFaces = indices.size() / 3;
+  const size_t numVertices = positions.size() / 3;
+  ASSERT_MSG(indices.size() <= UINT_MAX, "%zu corners do not fit the adjacency", indices.size());
+
+  // the face normals, in parallel
+  std::vector<double> faceNormals(3*numFaces);
+  std::vector<double> angles(weighting == AngleWeights ? 3*numFaces : 0);
+  pool.parallelFor(numFaces, 4096, [&](size_t begin, size_t end) {
+    face_normals(indices, positions, begin, end, weighting, &faceNormals[0],
+                 angles.empty() ? 0 : &angles[0]);
+  });
+
+  // the corners of each vertex in face order, by a counting sort
+  std::vector<unsigned int> first(numVertices + 1, 0);
+  for ( size_t i=0; i < indices.size(); i++ )
+    first[indices[i] + 1]++;
+  for ( size_t v=0; v < numVertices; v++ )
+    first[v+1] += first[v];
+  std::vector<unsigned int> corners(indices.size());
+  for ( size_t i=0; i < indices.size(); i++ )
+    corners[first[indices[i]]++] = (unsigned int)i;
+  for ( size_t v=numVertices; v > 0; v-- )
+    first[v] = first[v-1];
+  first[0] = 0;
 
   std::vector<float> & normals = m_shapes[idx].mesh.normals;
   if ( !normals.empty() )
     WARN("Overwriting exisiting normals...");
   normals.resize(positions.size());
 
-  for ( size_t i=0; i < indices.size(); i++ )
+  // sum the faces of each vertex in face order, as a serial pass would, so
+  // the normals do not depend on the number of threads; each vertex is
+  // written once
+  pool.parallelFor(numVertices, 16384, [&](size_t begin, size_t end) {
+    for ( size_t v=begin; v < end; v++ )
+    {
+      Vector3 n(Vector3::Zero());
+      for ( size_t i=first[v]; i < first[v+1]; i++ )
+      {
+        const size_t c = corners[i];
+        const double *face = &faceNormals[3*(c/3)];
+        const double weight = angles.empty() ? 1.0 : angles[c];
+        n += Vector3(weight * face[0], weight * face[1], weight * face[2]);
+      }
+      n.normalize();
+      normals[3*v  ] = float(n.x());
+      normals[3*v+1] = float(n.y());
+      normals[3*v+2] = float(n.z());
+    }
+  });
+}
+
+// transform the vertices of the triangle starting at indices[j]
+static void transform_vertices(Triangle &t, const tinyobj::mesh_t &mesh, size_t j,
+                               const EigenTypes::Matrix4 &transform)
+{
+  const std::vector<unsigned int> & indices = mesh.indices;
+  const std::vector<float> & positions = mesh.positions;
+  for ( size_t k=0; k < 3; k++ )
+  {
+    EigenTypes::Vector4 v(positions[3*indices[j+k]], positions[3*indices[j+k]+1], positions[3*indices[j+k]+2], 1.0);
+    v = transform * v;
+    v /= v.w();
+    t.vertices[k] = EigenTypes::Vector3(v.x(), v.y(), v.z());
+  }
+}
+
+static void transform_normals(Triangle &t, const tinyobj::mesh_t &mesh, size_t j,
+                              const EigenTypes::Matrix4 &normal_transform)
+{
+  const std::vector<unsigned int> & indices = mesh.indices;
+  const std::vector<float> & normals = mesh.normals;
+  for ( size_t k=0; k < 3; k++ )
+  {
+    EigenTypes::Vector4 n(normals[3*indices[j+k]], normals[3*indices[j+k]+1], normals[3*indices[j+k]+2], 1.0);
+    n = normal_transform * n;
+    t.normals[k] = EigenTypes::Vector3(n.x()/n.w(), n.y()/n.w(), n.z()/n.w());
+    t.normals[k].normalize();
+  }
+}
+
+// true if all three vertices are outside of the viewing volume
+static bool outside_view(const Triangle &t)
+{
+  for ( size_t k=0; k < 3; k++ )
   {
-    normals[3*indices[i]  ] = new_normals[indices[i]].x();
-    normals[3*indices[i]+1] = new_normals[indices[i]].y();
-    normals[3*indices[i]+2] = new_normals[indices[i]].z();
+    const EigenTypes::Vector3 &v = t.vertices[k];
+    if ( !(v.x() < -1.0f || v.x() > 1.0f ||
+           v.y() < -1.0f || v.y() > 1.0f ||
+           v.z() < -1.0f || v.z() > 1.0f) )
+      return false;
   }
+  return true;
+}
+
+void Model::getTriangles(std::vector<Triangle> &triangles, const Matrix4 &transform) const
+{
+  getTriangles(triangles, transform, 0, numTriangles());
 }
 
-void Model::getTriangles(std::vector<Triangle> &triangles, const Matrix4 &transform)
+void Model::getTriangles(std::vector<Triangle> &triangles, const Matrix4 &transform,
+                         size_t first, size_t last) const
 {
+  ASSERT_MSG(m_resident, "%s: geometry not loaded, acquire() the model first", m_filename.c_str());
   //const Matrix4 normal_transform = (transform.transpose()*transform).inverse()*transform.transpose();
   const Matrix4 normal_transform = transform.adjoint().transpose();
   //const Matrix4 normal_transform = transform.inverse().transpose();
-  //const Matrix4 &normal_transform = transform;
-
-  float x[2] = {99999.f, -99999.f};
-  float y[2] = {99999.f, -99999.f};
-  float z[2] = {99999.f, -99999.f};
 
-  size_t n_filtered = 0;
-  size_t n_remained = 0;
-
-  for ( size_t i=0; i < m_shapes.size(); i++ )
+  size_t base = 0;
+  for ( size_t i=0; i < m_shapes.size() && base < last; i++ )
   {
-    const std::vector<unsigned int> & indices = m_shapes[i].mesh.indices;
-    const std::vector<float> & positions = m_shapes[i].mesh.positions;
-    const std::vector<float> & normals = m_shapes[i].mesh.normals;
+    const tinyobj::mesh_t &mesh = m_shapes[i].mesh;
+    const size_t n = mesh.indices.size() / 3;
+    const size_t begin = std::max(first, base);
+    const size_t end = std::min(last, base + n);
 
-    for ( size_t j=0; j < indices.size(); j += 3 )
+    for ( size_t k=begin; k < end; k++ )
     {
+      const size_t j = 3*(k - base);
       Triangle t;
-
-      // do the transformation
-      for ( size_t k=0; k < 3; k++ )
-      {
-        Vector4 v(positions[3*indices[j+k]], positions[3*indices[j+k]+1], positions[3*indices[j+k]+2], 1.0);
-        v = transform * v;
-        v /= v.w();
-        t.vertices[k] = Vector3(v.x(), v.y(), v.z());
-      }
-
-      // do statistics about vertex info
-      for ( size_t k=0; k < 3; k++ )
-      {
-        x[0] = std::min(x[0], (float)(t.vertices[k].x()));
-        x[1] = std::max(x[1], (float)(t.vertices[k].x()));
-        y[0] = std::min(y[0], (float)(t.vertices[k].y()));
-        y[1] = std::max(y[1], (float)(t.vertices[k].y()));
-        z[0] = std::min(z[0], (float)(t.vertices[k].z()));
-        z[1] = std::max(z[1], (float)(t.vertices[k].z()));
-      }
-
-      // filter out this triangle if all three vertices are outside of the viewing volume
-      if ( (t.vertices[0].x() < -1.0f || t.vertices[0].x() > 1.0f ||
-            t.vertices[0].y() < -1.0f || t.vertices[0].y() > 1.0f ||
-            t.vertices[0].z() < -1.0f || t.vertices[0].z() > 1.0f )
-        && (t.vertices[1].x() < -1.0f || t.vertices[1].x() > 1.0f ||
-            t.vertices[1].y() < -1.0f || t.vertices[1].y() > 1.0f ||
-            t.vertices[1].z() < -1.0f || t.vertices[1].z() > 1.0f )
-        && (t.vertices[2].x() < -1.0f || t.vertices[2].x() > 1.0f ||
-            t.vertices[2].y() < -1.0f || t.vertices[2].y() > 1.0f ||
-            t.vertices[2].z() < -1.0f || t.vertices[2].z() > 1.0f ) )
-      {
-        n_filtered++;
-        continue;
-      }
-
-#if 1
-      // transform the normals as well
-      for ( size_t k=0; k < 3; k++ )
-      {
-        Vector4 n(normals[3*indices[j+k]], normals[3*indices[j+k]+1], normals[3*indices[j+k]+2], 1.0);
-        n = normal_transform * n;
-        t.normals[k] = Vector3(n.x()/n.w(), n.y()/n.w(), n.z()/n.w());
-        t.normals[k].normalize();
-      }
-#endif
-
-      // filter out this triangle if it's facing backward to viewer
-      // TODO: find out better solution
-      if (0)
-      //if ( t.normals[0].z() < 0 || t.normals[1].z() < 0 || t.normals[2].z() < 0 )
-      //if ( t.normals[0].z() + t.normals[1].z() + t.normals[2].z() < 0 )
-      {
-        n_filtered++;
+      transform_vertices(t, mesh, j, transform);
+      if ( outside_view(t) )
         continue;
-      }
-      if (0)
-      {
-        Vector3 n = t.normals[0] + t.normals[1] + t.normals[2];
-        n.normalize();
-
-        INFO("normal = (%.2f, %.2f, %.2f)", n.x(), n.y(), n.z());
-      }
-
+      transform_normals(t, mesh, j, normal_transform);
       triangles.push_back(t);
-      n_remained++;
     }
+    base += n;
+  }
+}
+
+void Triangle::bounds(int w, int h, int box[4]) const
+{
+  box[0] = box[1] = 99999;
+  box[2] = box[3] = -99999;
+  for ( size_t i=0; i < 3; i++ )
+  {
+    int xd = int((vertices[i].x() + 1.0f) / 2.0f * w);
+    int yd = int((vertices[i].y() + 1.0f) / 2.0f * h);
+    box[0] = std::min(box[0], xd);
+    box[1] = std::min(box[1], yd);
+    box[2] = std::max(box[2], xd);
+    box[3] = std::max(box[3], yd);
   }
-  INFO("range of x (before clip): (%.2f, %.2f)", x[0], x[1]);
-  INFO("range of y (before clip): (%.2f, %.2f)", y[0], y[1]);
-  INFO("range of z (before clip): (%.2f, %.2f)", z[0], z[1]);
-  INFO("filtered: %.2f%% (%lu/%lu)", 100.0f*n_filtered/(n_filtered+n_remained), n_filtered, n_filtered+n_remained);
 }
 
 void Triangle::raster(std::vector<Pixel> &pixels, int w, int h) const
+{
+  raster(pixels, w, h, INT_MIN, INT_MIN, INT_MAX, INT_MAX);
+}
+
+void Triangle::raster(std::vector<Pixel> &pixels, int w, int h,
+                      int xmin, int ymin, int xmax, int ymax) const
 {
   int x[2] = {99999, -99999};
   int y[2] = {99999, -99999};
@@ -242,6 +572,12 @@ void Triangle::raster(std::vector<Pixel> &pixels, int w, int h) const
     y[0] = std::min(y[0], yd[i]);
     y[1] = std::max(y[1], yd[i]);
   }
+  x[0] = std::max(x[0], xmin);
+  x[1] = std::min(x[1], xmax);
+  y[0] = std::max(y[0], ymin);
+  y[1] = std::min(y[1], ymax);
+  if ( x[0] > x[1] || y[0] > y[1] )
+    return;
 
   // construct maxtrix A
   Matrix3 A(Matrix3::Ones());
@@ -3,11 +3,16 @@
 
 #include <string>
 #include <vector>
+#include <list>
+#include <mutex>
+#include <atomic>
 #include <Eigen/Eigen>
 #include <stdint.h>
 #include "tiny_obj_loader.h"
 #include "Logger.hpp"
 
+class ThreadPool;
+
 struct EigenTypes {
   typedef Eigen::Vector3d Vector3;
   typedef Eigen::Vector4d Vector4;
@@ -29,20 +34,80 @@ struct Triangle : public EigenTypes
   Vector3 vertices[3];
   Vector3 normals[3];
 
+  /** \brief Discrete bounding box {xmin, ymin, xmax, ymax} in a w x h image.
+   */
+  void bounds(int w, int h, int box[4]) const;
   void raster(std::vector<Pixel> &pixels, int w, int h) const;
+  /// Same as above, restricted to pixels inside [xmin, xmax] x [ymin, ymax].
+  void raster(std::vector<Pixel> &pixels, int w, int h,
+              int xmin, int ymin, int xmax, int ymax) const;
   float getDepth(const Pixel &p) const;
   uint32_t getColor(const Pixel &p) const;
 };
 
 class Model : public EigenTypes {
 public:
+  /// How the normals of the faces around a vertex add up to its normal.
+  enum NormalWeighting {
+    EqualWeights,   /// every face counts the same, the default
+    AreaWeights,    /// faces count by their area
+    AngleWeights    /// faces count by their corner angle at the vertex
+  };
+
+  /// When the geometry of a model is loaded.
+  enum Loading {
+    Eager,          /// in the constructor, kept until destruction
+    Lazy            /// on the first acquire(), evicted again under the memory budget
+  };
 
 public:
-  Model(const char *filename);
+  /** \brief Load an OBJ or PLY file, from its MeshCache if that is up to date.
+   *
+   * Freshly parsed shapes go through MeshCleanup first if it is enabled.
+   *
+   * A Lazy model only reads the triangle count and bounds from the cache
+   * header, or the triangle count from a scan of the file if there is no
+   * cache (the face count of the header for PLY), and loads the geometry
+   * when it is first acquired.
+   *
+   * \param pool scheduler the file is parsed on, ThreadPool::instance() if null
+   */
+  explicit Model(const char *filename, ThreadPool *pool=0, Loading loading=Eager);
   ~Model();
 
+public:
+  /** \brief Keep the geometry in memory until the matching release(),
+   * loading it first if the model is lazy and not resident.
+   *
+   * The geometry accessors below need a resident model; renderers hold a
+   * pin for the duration of a frame. Does nothing for Eager models.
+   */
+  void acquire();
+  void release();
+  bool resident() const;
+  Loading loading() const;
+
+  /** \brief Bounds {min x, y, z, max x, y, z} over all shapes.
+   * \return false while unknown, for a lazy model without a cache that
+   * has not been loaded yet
+   */
+  bool bounds(float box[6]) const;
+
+  /** \brief Memory the geometry of resident Lazy models may take in total,
+   * 0 (the default) for no limit.
+   *
+   * When the total exceeds it, the least recently acquired models that
+   * are not pinned drop their geometry until it fits again; changes made
+   * with recalculateNormals() are lost then.
+   */
+  static void setMemoryBudget(size_t bytes);
+  static size_t memoryBudget();
+  /// Memory taken by the geometry of resident Lazy models.
+  static size_t residentBytes();
+
 public:
   void debug() const;
+  const std::string &filename() const;
   size_t numShapes() const;
   size_t vertexSize(size_t i) const;
   size_t normalSize(size_t i) const;
@@ -52,16 +117,65 @@ public:
   void *normalData(size_t i);
   void *indexData(size_t i);
 
-  void getTriangles(std::vector<Triangle> &triangles, const Matrix4 &transform);
+  /** \brief Geometry version, changes whenever the mesh data changes.
+   *
+   * Renderers use it to key cached frames; two models never share a version.
+   */
+  uint64_t version() const;
+
+  size_t numTriangles() const;
+
+  /** \brief Transform the triangles of the model and append those inside
+   * the viewing volume.
+   */
+  void getTriangles(std::vector<Triangle> &triangles, const Matrix4 &transform) const;
+  /** \brief Same as above for triangles [first, last) of the model, counted
+   * across all shapes; disjoint ranges can be processed concurrently.
+   */
+  void getTriangles(std::vector<Triangle> &triangles, const Matrix4 &transform,
+                    size_t first, size_t last) const;
+
+  /** \brief Replace the normals of all shapes by computed vertex normals.
+   *
+   * Loading computes EqualWeights normals for shapes without any.
+   */
+  void recalculateNormals(NormalWeighting weighting = EqualWeights);
 
 protected:
+  /// Fill m_shapes from the MeshCache or the file, and the metadata from them.
+  void load();
+  /// Evict unpinned Lazy models, least recently acquired first, until they fit the budget.
+  static void trimToBudget();
+
   /** \brief Calculate normals for each vertex.
+   *
+   * The face normals are computed in parallel, then each vertex sums
+   * those of its faces, found through a vertex to corner table; memory
+   * grows with the mesh, not with its face order or the thread count.
    */
-  void calculate_normal(size_t idx);
+  void calculate_normal(size_t idx, ThreadPool &pool, NormalWeighting weighting);
 
 protected:
   std::string m_filename;
   std::vector<tinyobj::shape_t> m_shapes;
+  std::atomic<uint64_t> m_version;
+  ThreadPool *m_pool;
+
+  // metadata, valid without the geometry; the bounds are guarded by the
+  // residency lock like the members below
+  std::atomic<size_t> m_numTriangles;
+  float m_bounds[6];
+  bool m_hasBounds;
+
+  // residency of Lazy models; m_pins, m_bytes and m_lruEntry are guarded
+  // by the lock of the list of lazy models, m_loadMutex serializes loads
+  Loading m_loading;
+  std::atomic<bool> m_resident;
+  bool m_modified;            /// normals recalculated since the last load
+  unsigned m_pins;
+  size_t m_bytes;
+  std::list<Model *>::iterator m_lruEntry;
+  std::mutex m_loadMutex;
 
 };
 
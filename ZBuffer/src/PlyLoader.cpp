@@ -0,0 +1,522 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdint.h>
+#include "PlyLoader.hpp"
+#include "MappedFile.hpp"
+#include "CLocale.hpp"
+
+namespace {
+
+enum Format { Ascii, BinaryLittleEndian, BinaryBigEndian };
+
+enum Type { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64, NUM_TYPES };
+
+const char *TYPE_NAMES[NUM_TYPES][2] = {
+  { "char", "int8" }, { "uchar", "uint8" }, { "short", "int16" }, { "ushort", "uint16" },
+  { "int", "int32" }, { "uint", "uint32" }, { "float", "float32" }, { "double", "float64" }
+};
+const size_t TYPE_SIZES[NUM_TYPES] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+
+/// What a property is read into.
+enum Target { Skip = -1, X, Y, Z, NX, NY, NZ, Indices };
+
+struct Property {
+  std::string name;
+  Type type;
+  Type countType;           /// for lists
+  bool list;
+  int target;
+};
+
+struct Element {
+  std::string name;
+  size_t count;
+  std::vector<Property> properties;
+};
+
+bool parse_type(const std::string &name, Type &type)
+{
+  for ( int i=0; i < NUM_TYPES; i++ )
+    if ( name == TYPE_NAMES[i][0] || name == TYPE_NAMES[i][1] )
+    {
+      type = Type(i);
+      return true;
+    }
+  return false;
+}
+
+bool host_is_little_endian()
+{
+  const uint16_t one = 1;
+  unsigned char first;
+  memcpy(&first, &one, 1);
+  return first == 1;
+}
+
+template <typename T>
+T load(const char *p, bool swap)
+{
+  char bytes[sizeof(T)];
+  memcpy(bytes, p, sizeof(T));
+  if ( swap )
+    std::reverse(bytes, bytes + sizeof(T));
+  T value;
+  memcpy(&value, bytes, sizeof(T));
+  return value;
+}
+
+/** \brief Values of the body in file order, from binary data or from
+ * whitespace separated ASCII tokens; sets failed() at the end of the data.
+ */
+class Reader {
+public:
+  Reader(const char *begin, const char *end, Format format)
+    : m_p(begin), m_end(end), m_ascii(format == Ascii),
+      m_swap(format != Ascii && (format == BinaryLittleEndian) != host_is_little_endian()),
+      m_failed(false)
+  {}
+
+  bool failed() const { return m_failed; }
+  bool swap() const { return m_swap; }
+  const char *pos() const { return m_p; }
+  size_t left() const { return m_end - m_p; }
+  void advance(size_t n) { m_p += n; }
+
+  double read(Type type)
+  {
+    if ( m_ascii )
+      return readToken(type);
+    if ( left() < TYPE_SIZES[type] )
+    {
+      m_failed = true;
+      return 0.0;
+    }
+    const char *p = m_p;
+    m_p += TYPE_SIZES[type];
+    switch ( type )
+    {
+    case Int8:    return (signed char)*p;
+    case UInt8:   return (unsigned char)*p;
+    case Int16:   return load<int16_t>(p, m_swap);
+    case UInt16:  return load<uint16_t>(p, m_swap);
+    case Int32:   return load<int32_t>(p, m_swap);
+    case UInt32:  return load<uint32_t>(p, m_swap);
+    case Float32: return load<float>(p, m_swap);
+    default:      return load<double>(p, m_swap);
+    }
+  }
+
+private:
+  double readToken(Type type)
+  {
+    while ( m_p < m_end && isspace((unsigned char)*m_p) )
+      m_p++;
+    const char *begin = m_p;
+    while ( m_p < m_end && !isspace((unsigned char)*m_p) )
+      m_p++;
+    char token[64];
+    const size_t n = m_p - begin;
+    if ( n == 0 || n >= sizeof(token) )
+    {
+      m_failed = true;
+      return 0.0;
+    }
+    memcpy(token, begin, n);
+    token[n] = '\0';
+    char *tokenEnd;
+    double value = (type == Float32 || type == Float64) ? strtod_c(token, &tokenEnd)
+                                                        : double(strtoll(token, &tokenEnd, 10));
+    if ( tokenEnd != token + n )
+      m_failed = true;
+    return value;
+  }
+
+private:
+  const char *m_p;
+  const char *m_end;
+  bool m_ascii;
+  bool m_swap;
+  bool m_failed;
+};
+
+/// Next header line in [p, end) without the line break; p moves past it.
+bool next_line(const char *&p, const char *end, std::string &line)
+{
+  if ( p >= end )
+    return false;
+  const char *lineEnd = (const char*)memchr(p, '\n', end - p);
+  if ( !lineEnd )
+    lineEnd = end;
+  line.assign(p, lineEnd);
+  if ( !line.empty() && line[line.size()-1] == '\r' )
+    line.erase(line.size()-1);
+  p = (lineEnd < end) ? lineEnd + 1 : end;
+  return true;
+}
+
+bool parse_header(const char *&p, const char *end, Format &format,
+                  std::vector<Element> &elements, std::string &err)
+{
+  std::string line;
+  if ( !next_line(p, end, line) || line != "ply" )
+  {
+    err = "not a PLY file";
+    return false;
+  }
+  bool hasFormat = false;
+  while ( next_line(p, end, line) )
+  {
+    std::istringstream in(line);
+    std::string keyword;
+    in >> keyword;
+    if ( keyword == "end_header" )
+    {
+      if ( !hasFormat )
+        err = "missing format line";
+      return hasFormat;
+    }
+    else if ( keyword == "format" )
+    {
+      std::string name;
+      in >> name;
+      if ( name == "ascii" )
+        format = Ascii;
+      else if ( name == "binary_little_endian" )
+        format = BinaryLittleEndian;
+      else if ( name == "binary_big_endian" )
+        format = BinaryBigEndian;
+      else
+      {
+        err = "unknown format " + name;
+        return false;
+      }
+      hasFormat = true;
+    }
+    else if ( keyword == "element" )
+    {
+      Element element;
+      long long count = -1;
+      in >> element.name >> count;
+      if ( !in || count < 0 )
+      {
+        err = "bad element line: " + line;
+        return false;
+      }
+      element.count = size_t(count);
+      elements.push_back(element);
+    }
+    else if ( keyword == "property" )
+    {
+      Property property;
+      std::string type;
+      in >> type;
+      property.list = (type == "list");
+      property.countType = UInt8;
+      if ( property.list )
+      {
+        std::string countType;
+        in >> countType >> type;
+        if ( !parse_type(countType, property.countType) || property.countType == Float32
+             || property.countType == Float64 )
+        {
+          err = "bad list count type in: " + line;
+          return false;
+        }
+      }
+      in >> property.name;
+      if ( !in || elements.empty() || !parse_type(type, property.type) )
+      {
+        err = "bad property line: " + line;
+        return false;
+      }
+      property.target = Skip;
+      elements.back().properties.push_back(property);
+    }
+    // comment, obj_info and unknown keywords are ignored
+  }
+  err = "missing end_header";
+  return false;
+}
+
+/** \brief Check the element counts against the body size before anything
+ * is allocated for them: a record takes at least its fixed-size values and
+ * list counts in a binary file, and one byte per value in an ASCII one.
+ */
+bool check_counts(const std::vector<Element> &elements, Format format, size_t left,
+                  std::string &err)
+{
+  for ( size_t e=0; e < elements.size(); e++ )
+  {
+    const Element &element = elements[e];
+    size_t record = 0;
+    for ( size_t k=0; k < element.properties.size(); k++ )
+    {
+      const Property &property = element.properties[k];
+      if ( format == Ascii )
+        record += 1;
+      else
+        record += TYPE_SIZES[property.list ? property.countType : property.type];
+    }
+    if ( record > 0 && element.count > left / record )
+    {
+      err = "element " + element.name + " does not fit in the file";
+      return false;
+    }
+    left -= element.count * record;
+  }
+  return true;
+}
+
+/// Vertex element without lists, all wanted properties float: copy them out.
+bool read_float_vertices(Reader &reader, const Element &element, std::vector<float> *targets[6])
+{
+  size_t stride = 0;
+  size_t offsets[6];
+  for ( size_t k=0; k < element.properties.size(); k++ )
+  {
+    const Property &property = element.properties[k];
+    if ( property.list )
+      return false;
+    if ( property.target >= X && property.target <= NZ )
+    {
+      if ( property.type != Float32 )
+        return false;
+      offsets[property.target] = stride;
+    }
+    stride += TYPE_SIZES[property.type];
+  }
+  if ( reader.left() / stride < element.count )
+    return false;                   // let the generic path report it
+
+  // one pass over the block
+  const char *in = reader.pos();
+  const bool swap = reader.swap();
+  float *positions = targets[X]->data();
+  float *normals = targets[NX] ? targets[NX]->data() : 0;
+  for ( size_t i=0; i < element.count; i++, in += stride )
+    for ( int k=0; k < 3; k++ )
+    {
+      positions[3*i + k] = load<float>(in + offsets[X + k], swap);
+      if ( normals )
+        normals[3*i + k] = load<float>(in + offsets[NX + k], swap);
+    }
+  reader.advance(element.count * stride);
+  return true;
+}
+
+/// Face element of only a triangle index list: read the indices directly.
+bool read_triangle_faces(Reader &reader, const Element &element, size_t numVertices,
+                         std::vector<unsigned int> &indices, std::string &err)
+{
+  if ( element.properties.size() != 1 )
+    return false;
+  const Property &property = element.properties[0];
+  if ( property.target != Indices || property.countType != UInt8
+       || (property.type != Int32 && property.type != UInt32) )
+    return false;
+
+  const size_t stride = 1 + 3*sizeof(uint32_t);
+  if ( reader.left() / stride < element.count )
+    return false;
+
+  // all triangles? otherwise take the generic path from the start
+  const char *data = reader.pos();
+  for ( size_t i=0; i < element.count; i++ )
+    if ( (unsigned char)data[i*stride] != 3 )
+      return false;
+
+  const bool swap = reader.swap();
+  const size_t first = indices.size();
+  indices.resize(first + 3*element.count);
+  unsigned int *out = indices.data() + first;
+  for ( size_t i=0; i < element.count; i++, data += stride )
+    for ( size_t k=0; k < 3; k++ )
+    {
+      const uint32_t index = load<uint32_t>(data + 1 + 4*k, swap);
+      if ( index >= numVertices )   // negative int32 wraps around as well
+      {
+        err = "face index out of range";
+        return true;
+      }
+      *out++ = index;
+    }
+  reader.advance(element.count * stride);
+  return true;
+}
+
+} // namespace
+
+bool PlyLoader::isPly(const char *filename)
+{
+  const size_t n = strlen(filename);
+  if ( n < 4 || filename[n-4] != '.' )
+    return false;
+  return tolower(filename[n-3]) == 'p' && tolower(filename[n-2]) == 'l'
+      && tolower(filename[n-1]) == 'y';
+}
+
+size_t PlyLoader::countFaces(const char *filename)
+{
+  MappedFile file;
+  if ( !file.open(filename) )
+    return 0;
+
+  const char *p = file.data();
+  Format format = Ascii;
+  std::vector<Element> elements;
+  std::string err;
+  if ( !parse_header(p, p + file.size(), format, elements, err) )
+    return 0;
+  for ( size_t i=0; i < elements.size(); i++ )
+    if ( elements[i].name == "face" )
+      return elements[i].count;
+  return 0;
+}
+
+std::string PlyLoader::load(std::vector<tinyobj::shape_t> &shapes, const char *filename)
+{
+  shapes.clear();
+
+  MappedFile file;
+  if ( !file.open(filename) )
+    return std::string("Cannot open file [") + filename + "]\n";
+
+  const char *p = file.data();
+  const char *end = p + file.size();
+  Format format = Ascii;
+  std::vector<Element> elements;
+  std::string err;
+  if ( !parse_header(p, end, format, elements, err) )
+    return std::string(filename) + ": " + err + "\n";
+
+  Element *vertices = 0;
+  Element *faces = 0;
+  for ( size_t i=0; i < elements.size(); i++ )
+  {
+    if ( elements[i].name == "vertex" && !vertices )
+      vertices = &elements[i];
+    else if ( elements[i].name == "face" && !faces )
+      faces = &elements[i];
+  }
+  if ( !vertices )
+    return std::string(filename) + ": no vertex element\n";
+
+  // map the properties we need onto targets
+  static const char *VERTEX_NAMES[6] = { "x", "y", "z", "nx", "ny", "nz" };
+  int found = 0;
+  for ( size_t k=0; k < vertices->properties.size(); k++ )
+    for ( int t=X; t <= NZ; t++ )
+      if ( !vertices->properties[k].list && vertices->properties[k].name == VERTEX_NAMES[t]
+           && !(found & (1 << t)) )
+      {
+        vertices->properties[k].target = t;
+        found |= 1 << t;
+      }
+  if ( (found & 7) != 7 )
+    return std::string(filename) + ": vertex element without x, y, z\n";
+  const bool hasNormals = (found & 0x38) == 0x38;
+  if ( !hasNormals )
+    for ( size_t k=0; k < vertices->properties.size(); k++ )
+      if ( vertices->properties[k].target >= NX )
+        vertices->properties[k].target = Skip;
+  if ( faces )
+    for ( size_t k=0; k < faces->properties.size(); k++ )
+      if ( faces->properties[k].list && (faces->properties[k].name == "vertex_indices"
+                                         || faces->properties[k].name == "vertex_index") )
+      {
+        faces->properties[k].target = Indices;
+        break;
+      }
+
+  if ( !check_counts(elements, format, end - p, err) )
+    return std::string(filename) + ": " + err + "\n";
+
+  tinyobj::mesh_t mesh;
+  mesh.positions.resize(3 * vertices->count);
+  if ( hasNormals )
+    mesh.normals.resize(3 * vertices->count);
+  std::vector<float> *targets[6] = { &mesh.positions, &mesh.positions, &mesh.positions,
+                                     hasNormals ? &mesh.normals : 0, hasNormals ? &mesh.normals : 0,
+                                     hasNormals ? &mesh.normals : 0 };
+
+  Reader reader(p, end, format);
+  std::vector<long long> polygon;
+  for ( size_t e=0; e < elements.size() && err.empty(); e++ )
+  {
+    const Element &element = elements[e];
+    if ( format != Ascii && &element == vertices && read_float_vertices(reader, element, targets) )
+      continue;
+    if ( format != Ascii && &element == faces
+         && read_triangle_faces(reader, element, vertices->count, mesh.indices, err) )
+      continue;
+
+    for ( size_t i=0; i < element.count && err.empty(); i++ )
+    {
+      for ( size_t k=0; k < element.properties.size(); k++ )
+      {
+        const Property &property = element.properties[k];
+        if ( !property.list )
+        {
+          const double value = reader.read(property.type);
+          if ( property.target >= X && property.target <= NZ )
+            (*targets[property.target])[3*i + property.target % 3] = float(value);
+          continue;
+        }
+
+        // a list holds whole values, binary ones of their size and ASCII
+        // ones at least a byte each, so it cannot be longer than the rest
+        // of the file; checked before anything is allocated for it
+        const double count = reader.read(property.countType);
+        const size_t valueSize = (format == Ascii) ? 1 : TYPE_SIZES[property.type];
+        if ( reader.failed() || !(count >= 0) || count != std::floor(count)
+             || count > double(reader.left() / valueSize) )
+        {
+          err = "bad list length";
+          break;
+        }
+        if ( property.target != Indices )
+        {
+          if ( format != Ascii )
+            reader.advance(size_t(count) * valueSize);
+          else
+            for ( size_t j=0; j < size_t(count); j++ )
+              reader.read(property.type);
+          continue;
+        }
+
+        // polygon -> triangle fan
+        polygon.resize(size_t(count));
+        for ( size_t j=0; j < polygon.size(); j++ )
+        {
+          polygon[j] = (long long)reader.read(property.type);
+          if ( polygon[j] < 0 || polygon[j] >= (long long)vertices->count )
+            err = "face index out of range";
+        }
+        for ( size_t j=2; j < polygon.size() && err.empty(); j++ )
+        {
+          mesh.indices.push_back((unsigned int)polygon[0]);
+          mesh.indices.push_back((unsigned int)polygon[j-1]);
+          mesh.indices.push_back((unsigned int)polygon[j]);
+        }
+      }
+      if ( reader.failed() && err.empty() )
+        err = "unexpected end of file";
+    }
+  }
+  if ( !err.empty() )
+    return std::string(filename) + ": " + err + "\n";
+
+  // a point cloud has nothing to render, leave the model without shapes
+  if ( mesh.indices.empty() )
+    return std::string();
+
+  shapes.resize(1);
+  shapes[0].mesh.positions.swap(mesh.positions);
+  shapes[0].mesh.normals.swap(mesh.normals);
+  shapes[0].mesh.indices.swap(mesh.indices);
+  return std::string();
+}
@@ -0,0 +1,33 @@
+#ifndef __PLY_LOADER_HPP__
+#define __PLY_LOADER_HPP__
+
+#include <string>
+#include <vector>
+#include "tiny_obj_loader.h"
+
+/** \brief Stanford PLY reader producing the same shapes as tinyobj::LoadObj.
+ *
+ * Reads ASCII, binary little endian and binary big endian files. The file
+ * is memory mapped; binary vertex and face blocks are read straight into
+ * the position, normal and index arrays without any text parsing.
+ *
+ * The "vertex" element provides x, y, z and, if present, nx, ny, nz; the
+ * "face" element provides vertex_indices (or vertex_index), polygons are
+ * split into triangle fans. Other elements and properties are skipped.
+ * The result is a single unnamed shape, or none for a file without faces.
+ */
+struct PlyLoader {
+  /// \return an empty string on success, the error message otherwise
+  static std::string load(std::vector<tinyobj::shape_t> &shapes, const char *filename);
+
+  /** \brief Size of the face element from the header alone, without
+   * reading any data; the triangle count of triangle meshes.
+   * \return 0 if the file cannot be read or has no faces
+   */
+  static size_t countFaces(const char *filename);
+
+  /// true if filename ends in .ply, in any case
+  static bool isPly(const char *filename);
+};
+
+#endif //__PLY_LOADER_HPP__
@@ -0,0 +1,51 @@
+#include <algorithm>
+#include <cstdio>
+#include "RenderStats.hpp"
+
+void RenderStats::reset()
+{
+  trianglesSubmitted = 0;
+  trianglesFrustumCulled = 0;
+  trianglesBackfaceCulled = 0;
+  trianglesRasterized = 0;
+  fragments = 0;
+  depthPassed = 0;
+  depthFailed = 0;
+  shaded = 0;
+  coveredPixels = 0;
+  maxDepthComplexity = 0;
+}
+
+RenderStats &RenderStats::operator+=(const RenderStats &other)
+{
+  trianglesSubmitted += other.trianglesSubmitted;
+  trianglesFrustumCulled += other.trianglesFrustumCulled;
+  trianglesBackfaceCulled += other.trianglesBackfaceCulled;
+  trianglesRasterized += other.trianglesRasterized;
+  fragments += other.fragments;
+  depthPassed += other.depthPassed;
+  depthFailed += other.depthFailed;
+  shaded += other.shaded;
+  coveredPixels += other.coveredPixels;
+  maxDepthComplexity = std::max(maxDepthComplexity, other.maxDepthComplexity);
+  return *this;
+}
+
+double RenderStats::averageDepthComplexity() const
+{
+  return coveredPixels ? double(fragments) / coveredPixels : 0.0;
+}
+
+std::string RenderStats::toString() const
+{
+  char buf[256];
+  snprintf(buf, sizeof(buf),
+           "tris %llu (frustum %llu back %llu raster %llu) frags %llu (pass %llu fail %llu) "
+           "shaded %llu depth complexity avg %.2f max %u",
+           (unsigned long long)trianglesSubmitted, (unsigned long long)trianglesFrustumCulled,
+           (unsigned long long)trianglesBackfaceCulled, (unsigned long long)trianglesRasterized,
+           (unsigned long long)fragments, (unsigned long long)depthPassed,
+           (unsigned long long)depthFailed, (unsigned long long)shaded,
+           averageDepthComplexity(), maxDepthComplexity);
+  return buf;
+}
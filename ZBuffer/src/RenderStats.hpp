@@ -0,0 +1,36 @@
+#ifndef __RENDER_STATS_HPP__
+#define __RENDER_STATS_HPP__
+
+#include <string>
+#include <stdint.h>
+
+/** \brief Work done by the pipeline in one or more frames.
+ *
+ * Every submitted triangle ends up in exactly one of the culled or
+ * rasterized counters, and every fragment either passes or fails the depth
+ * test. Together with FrameTimings these tell whether a model is transform,
+ * raster or shading bound.
+ */
+struct RenderStats {
+  uint64_t trianglesSubmitted;
+  uint64_t trianglesFrustumCulled;    /// outside the view volume or the image
+  uint64_t trianglesBackfaceCulled;   /// only with back-face culling enabled
+  uint64_t trianglesRasterized;       /// binned into at least one tile
+  uint64_t fragments;                 /// pixels covered by rasterized triangles
+  uint64_t depthPassed;
+  uint64_t depthFailed;
+  uint64_t shaded;                    /// shading invocations, one per visible pixel
+  uint64_t coveredPixels;             /// pixels with at least one fragment
+  uint32_t maxDepthComplexity;        /// most fragments of any single pixel
+
+  RenderStats() { reset(); }
+  void reset();
+  RenderStats &operator+=(const RenderStats &other);
+
+  /// Fragments per covered pixel; 1 means no overdraw at all.
+  double averageDepthComplexity() const;
+  /// One line "tris 1000 (frustum 10 back 0 raster 990) frags ..." for logs.
+  std::string toString() const;
+};
+
+#endif //__RENDER_STATS_HPP__
@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <cmath>
+#include "Renderer.hpp"
+
+const uint32_t Renderer::BACKGROUND;
+const size_t Renderer::TRANSFORM_BATCH;
+const int Renderer::TILE_SIZE;
+const size_t Renderer::CANCEL_BATCH;
+const int Renderer::MAX_OVERDRAW;
+
+Renderer::Renderer(ThreadPool *pool)
+  : m_pool(pool ? pool : &ThreadPool::instance()),
+    m_priority(ThreadPool::Normal),
+    m_backfaceCulling(false),
+    m_shadingMode(Phong),
+    m_traceId(-1)
+{
+}
+
+void Renderer::setPriority(ThreadPool::Priority priority)
+{
+  m_priority = priority;
+}
+
+void Renderer::setBackfaceCulling(bool enabled)
+{
+  m_backfaceCulling = enabled;
+}
+
+void Renderer::setShadingMode(ShadingMode mode)
+{
+  m_shadingMode = mode;
+}
+
+void Renderer::setTraceId(int id)
+{
+  m_traceId = id;
+}
+
+const char *Renderer::name(ShadingMode mode)
+{
+  static const char *names[NUM_SHADING_MODES] = { "phong", "overdraw", "tile cost" };
+  return names[mode];
+}
+
+// blue - cyan - green - yellow - red for t from 0 to 1
+static uint32_t heat_color(double t)
+{
+  t = std::min(1.0, std::max(0.0, t)) * 4.0;
+  const int segment = std::min(3, int(t));
+  const int f = int(255 * (t - segment));
+  int r = 0, g = 0, b = 0;
+  switch ( segment )
+  {
+  case 0: g = f;       b = 255;     break;
+  case 1: g = 255;     b = 255 - f; break;
+  case 2: r = f;       g = 255;     break;
+  case 3: r = 255;     g = 255 - f; break;
+  }
+  return 0xff000000 | r << 16 | g << 8 | b;
+}
+
+// average of two ARGB32 colors
+static uint32_t blend(uint32_t a, uint32_t b)
+{
+  return 0xff000000 | (((a & 0xfefefe) >> 1) + ((b & 0xfefefe) >> 1));
+}
+
+// twice the signed area of the projected triangle, positive if counter-clockwise
+static double signed_area(const Triangle &t)
+{
+  return (t.vertices[1].x() - t.vertices[0].x()) * (t.vertices[2].y() - t.vertices[0].y())
+       - (t.vertices[2].x() - t.vertices[0].x()) * (t.vertices[1].y() - t.vertices[0].y());
+}
+
+bool Renderer::render(const Model &model, const Camera &camera, FrameBuffer &fb,
+                      const CancelFn &cancelled)
+{
+  ScopedTimer frameTimer(m_timings.wallMs);
+  TraceScope frameTrace("frame", m_traceId);
+  m_timings.reset();
+  m_stats.reset();
+
+  const int width = fb.width();
+  const int height = fb.height();
+  {
+    ScopedTimer timer(m_timings.ms[FrameTimings::Clear]);
+    fb.clear(BACKGROUND);
+  }
+  if ( width <= 0 || height <= 0 )
+    return true;
+
+  /* This is how our algorithms work:
+   * 0. Setup model matrix
+   * 1. Setup view matrix (camera)
+   * 2. Setup projection matrix
+   * 3. Find out all triangles in the viewing frustum
+   * 4. Filter out all triangles facing backward to camera (optional)
+   * 5. Bin triangles into the screen tiles their bounding boxes touch
+   * 6. Rasterize each tile's triangles into pixels, keep the nearest
+   * 7. Set each pixel of the image to its nearest triangle pixel's color
+   *
+   * Steps 3-5 run in parallel over batches of triangles, steps 6-7 over
+   * tiles.
+   */
+  const Matrix4 transform = camera.transform((float)width/height);
+
+  const int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+  const int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+  const size_t numTiles = size_t(tilesX) * tilesY;
+
+  const size_t numTriangles = model.numTriangles();
+  const size_t numBatches = (numTriangles + TRANSFORM_BATCH - 1) / TRANSFORM_BATCH;
+  m_triangles.resize(numBatches);
+  m_bins.resize(numBatches);
+  m_batchTimings.assign(numBatches, FrameTimings());
+  m_tileTimings.assign(numTiles, FrameTimings());
+  m_batchStats.assign(numBatches, RenderStats());
+  m_tileStats.assign(numTiles, RenderStats());
+
+  m_pool->parallelFor(numBatches, 1, [&](size_t begin, size_t end) {
+    for ( size_t b=begin; b < end; b++ )
+    {
+      std::vector<Triangle> &batch = m_triangles[b];
+      std::vector<std::vector<uint32_t> > &bins = m_bins[b];
+      FrameTimings &timings = m_batchTimings[b];
+      RenderStats &stats = m_batchStats[b];
+      batch.clear();
+      bins.resize(numTiles);
+      for ( size_t tile=0; tile < numTiles; tile++ )
+        bins[tile].clear();
+
+      if ( cancelled && cancelled() )
+        return;
+
+      {
+        ScopedTimer timer(timings.ms[FrameTimings::Transform]);
+        TraceScope trace("transform", m_traceId, int(b));
+        const size_t first = b*TRANSFORM_BATCH;
+        const size_t last = std::min(numTriangles, (b+1)*TRANSFORM_BATCH);
+        model.getTriangles(batch, transform, first, last);
+        stats.trianglesSubmitted = last - first;
+        stats.trianglesFrustumCulled = stats.trianglesSubmitted - batch.size();
+      }
+
+      ScopedTimer timer(timings.ms[FrameTimings::Setup]);
+      TraceScope trace("bin", m_traceId, int(b));
+      for ( size_t i=0; i < batch.size(); i++ )
+      {
+        int box[4];
+        batch[i].bounds(width, height, box);
+        if ( box[2] < 0 || box[3] < 0 || box[0] >= width || box[1] >= height )
+        {
+          stats.trianglesFrustumCulled++;
+          continue;
+        }
+        if ( m_backfaceCulling && signed_area(batch[i]) < 0.0 )
+        {
+          stats.trianglesBackfaceCulled++;
+          continue;
+        }
+        stats.trianglesRasterized++;
+        int tx0 = std::max(0, box[0]) / TILE_SIZE;
+        int ty0 = std::max(0, box[1]) / TILE_SIZE;
+        int tx1 = std::min(width-1, box[2]) / TILE_SIZE;
+        int ty1 = std::min(height-1, box[3]) / TILE_SIZE;
+        for ( int ty=ty0; ty <= ty1; ty++ )
+          for ( int tx=tx0; tx <= tx1; tx++ )
+            bins[ty*tilesX+tx].push_back(uint32_t(i));
+      }
+    }
+  }, m_priority);
+
+  if ( cancelled && cancelled() )
+    return false;
+
+  float *zbuffer = fb.depth();
+  const double overdrawScale = 1.0 / std::log2(double(MAX_OVERDRAW));
+
+  m_pool->parallelFor(numTiles, 1, [&](size_t begin, size_t end) {
+    // visibility buffer: nearest triangle and its barycentric coordinates
+    std::vector<const Triangle*> visible(TILE_SIZE*TILE_SIZE);
+    std::vector<Vector3> coords(TILE_SIZE*TILE_SIZE);
+    std::vector<uint32_t> depthComplexity(TILE_SIZE*TILE_SIZE);
+    std::vector<const Triangle*> batch;
+    std::vector<Pixel> pixels;
+    std::vector<size_t> offsets;
+    batch.reserve(CANCEL_BATCH);
+
+    for ( size_t tile=begin; tile < end; tile++ )
+    {
+      const int x0 = int(tile % tilesX) * TILE_SIZE;
+      const int y0 = int(tile / tilesX) * TILE_SIZE;
+      const int x1 = std::min(width, x0 + TILE_SIZE) - 1;
+      const int y1 = std::min(height, y0 + TILE_SIZE) - 1;
+      FrameTimings &timings = m_tileTimings[tile];
+      RenderStats &stats = m_tileStats[tile];
+      std::fill(visible.begin(), visible.end(), (const Triangle*)0);
+      std::fill(depthComplexity.begin(), depthComplexity.end(), 0u);
+
+      // raster a batch of triangles into fragments, then depth test them
+      auto drawBatch = [&]() {
+        pixels.clear();
+        offsets.clear();
+        {
+          ScopedTimer timer(timings.ms[FrameTimings::Raster]);
+          for ( size_t k=0; k < batch.size(); k++ )
+          {
+            offsets.push_back(pixels.size());
+            batch[k]->raster(pixels, width, height, x0, y0, x1, y1);  // get all pixels in discrete coordinates
+          }
+          offsets.push_back(pixels.size());
+        }
+        stats.fragments += pixels.size();
+
+        ScopedTimer timer(timings.ms[FrameTimings::Depth]);
+        for ( size_t k=0; k < batch.size(); k++ )
+        {
+          const Triangle &t = *batch[k];
+          for ( size_t j=offsets[k]; j < offsets[k+1]; j++ )
+          {
+            const Pixel &p = pixels[j];
+            float depth = t.getDepth(p);      // we get depth of a pixel using barycentric coordinates
+            float &z = zbuffer[size_t(p.y)*width + p.x];
+            const size_t v = size_t(p.y-y0)*TILE_SIZE + (p.x-x0);
+            depthComplexity[v]++;
+            if ( depth < z )
+            {
+              z = depth;
+              stats.depthPassed++;
+              visible[v] = &t;
+              coords[v] = p.t;
+            }
+          }
+        }
+        batch.clear();
+      };
+
+      {
+        TraceScope trace("raster", m_traceId, int(tile));
+        for ( size_t b=0; b < numBatches; b++ )
+        {
+          const std::vector<uint32_t> &bin = m_bins[b][tile];
+          for ( size_t i=0; i < bin.size(); i++ )
+          {
+            batch.push_back(&m_triangles[b][bin[i]]);
+            if ( batch.size() == CANCEL_BATCH )
+            {
+              if ( cancelled && cancelled() )
+                return;
+              drawBatch();
+            }
+          }
+        }
+        drawBatch();
+      }
+
+      // per-tile counters, merged into m_stats once the frame is done
+      for ( int y=0; y <= y1-y0; y++ )
+        for ( int x=0; x <= x1-x0; x++ )
+        {
+          const size_t v = size_t(y)*TILE_SIZE + x;
+          stats.shaded += (visible[v] != 0 && m_shadingMode != Overdraw);
+          stats.coveredPixels += (depthComplexity[v] != 0);
+          stats.maxDepthComplexity = std::max(stats.maxDepthComplexity, depthComplexity[v]);
+        }
+      stats.depthFailed = stats.fragments - stats.depthPassed;
+
+      ScopedTimer timer(timings.ms[FrameTimings::Shade]);
+      TraceScope trace("shade", m_traceId, int(tile));
+      for ( int y=y0; y <= y1; y++ )
+      {
+        uint32_t *row = fb.scanLine(height-y-1);
+        for ( int x=x0; x <= x1; x++ )
+        {
+          const size_t v = size_t(y-y0)*TILE_SIZE + (x-x0);
+          if ( m_shadingMode == Overdraw )
+          {
+            if ( depthComplexity[v] )
+              row[x] = heat_color(std::log2(double(depthComplexity[v])) * overdrawScale);
+          }
+          else if ( visible[v] )
+            row[x] = visible[v]->getColor(Pixel(x, y, coords[v]));
+        }
+      }
+    }
+  }, m_priority);
+
+  if ( cancelled && cancelled() )
+    return false;
+
+  for ( size_t b=0; b < numBatches; b++ )
+  {
+    m_timings += m_batchTimings[b];
+    m_stats += m_batchStats[b];
+  }
+  for ( size_t tile=0; tile < numTiles; tile++ )
+  {
+    m_timings += m_tileTimings[tile];
+    m_stats += m_tileStats[tile];
+  }
+
+  if ( m_shadingMode == TileCost )
+  {
+    std::vector<double> cost(numTiles);
+    double maxCost = 0.0;
+    for ( size_t tile=0; tile < numTiles; tile++ )
+    {
+      const FrameTimings &t = m_tileTimings[tile];
+      cost[tile] = t.ms[FrameTimings::Raster] + t.ms[FrameTimings::Depth] + t.ms[FrameTimings::Shade];
+      maxCost = std::max(maxCost, cost[tile]);
+    }
+    for ( int y=0; y < height; y++ )
+    {
+      uint32_t *row = fb.scanLine(height-y-1);
+      for ( int x=0; x < width; x++ )
+      {
+        const size_t tile = size_t(y / TILE_SIZE) * tilesX + x / TILE_SIZE;
+        row[x] = blend(row[x], heat_color(maxCost > 0.0 ? cost[tile] / maxCost : 0.0));
+      }
+    }
+  }
+  return true;
+}
@@ -0,0 +1,114 @@
+#ifndef __RENDERER_HPP__
+#define __RENDERER_HPP__
+
+#include <functional>
+#include <vector>
+#include <stdint.h>
+#include "Model.hpp"
+#include "Camera.hpp"
+#include "FrameBuffer.hpp"
+#include "FrameTimings.hpp"
+#include "RenderStats.hpp"
+#include "ThreadPool.hpp"
+#include "Trace.hpp"
+
+/** \brief Tiled z-buffer renderer drawing a Model into a FrameBuffer.
+ *
+ * Triangles are transformed and binned into screen tiles in parallel
+ * batches, then each tile is rasterized by one task. Tiles visit their
+ * triangles in model order, so the result is identical to drawing the
+ * triangles one after another, whatever the number of threads.
+ *
+ * Within a tile, batches of triangles are rasterized into fragments and
+ * depth tested into a visibility buffer; the surviving fragment of each
+ * pixel is shaded once after all triangles of the tile are done.
+ *
+ * A Renderer keeps its scratch buffers between frames; use one instance
+ * per concurrently rendered image.
+ */
+class Renderer : public EigenTypes {
+public:
+  /// Returns true when the frame in progress should be abandoned.
+  typedef std::function<bool()> CancelFn;
+
+  /// What the color of a pixel shows.
+  enum ShadingMode {
+    Phong,          /// the lit model
+    Overdraw,       /// fragments rasterized into the pixel, blue 1 to red MAX_OVERDRAW
+    TileCost,       /// raster, depth and shade time of the tile over the lit model
+    NUM_SHADING_MODES
+  };
+
+  /// Background color, same as Qt::darkGray.
+  static const uint32_t BACKGROUND = 0xff808080;
+  /// Triangles transformed and binned per task.
+  static const size_t TRANSFORM_BATCH = 4096;
+  /// Edge length of the screen tiles rasterized per task.
+  static const int TILE_SIZE = 64;
+  /// The cancel function is polled between batches of this many triangles.
+  static const size_t CANCEL_BATCH = 256;
+  /// Depth complexity shown in full red by the Overdraw mode.
+  static const int MAX_OVERDRAW = 32;
+
+public:
+  /// \param pool scheduler to run on, ThreadPool::instance() if null
+  explicit Renderer(ThreadPool *pool=0);
+
+public:
+  void setPriority(ThreadPool::Priority priority);
+  ThreadPool::Priority priority() const { return m_priority; }
+
+  /** \brief Skip triangles facing away from the camera; off by default.
+   *
+   * Front faces wind counter-clockwise on screen, as exported by most
+   * modelling tools. Only enable it for closed meshes with consistent
+   * winding, otherwise holes appear where the back side is visible.
+   */
+  void setBackfaceCulling(bool enabled);
+  bool backfaceCulling() const { return m_backfaceCulling; }
+
+  /** \brief Replace Phong shading by a heatmap for debugging.
+   *
+   * TileCost is scaled to the most expensive tile of the frame, so colors
+   * compare tiles within a frame, not across frames.
+   */
+  void setShadingMode(ShadingMode mode);
+  ShadingMode shadingMode() const { return m_shadingMode; }
+  static const char *name(ShadingMode mode);
+
+  /// Widget id attached to the Trace events of this renderer.
+  void setTraceId(int id);
+
+  /** \brief Clear fb and draw model as seen by camera.
+   *
+   * \return false if cancelled() returned true; fb is then incomplete.
+   */
+  bool render(const Model &model, const Camera &camera, FrameBuffer &fb,
+              const CancelFn &cancelled=CancelFn());
+
+  /// Fragments produced by the rasterizer in the last frame.
+  size_t fragments() const { return size_t(m_stats.fragments); }
+  /// Per-stage times of the last frame; Present is left at zero.
+  const FrameTimings &timings() const { return m_timings; }
+  /// Pipeline counters of the last frame.
+  const RenderStats &stats() const { return m_stats; }
+
+private:
+  ThreadPool *m_pool;
+  ThreadPool::Priority m_priority;
+  bool m_backfaceCulling;
+  ShadingMode m_shadingMode;
+  int m_traceId;
+  FrameTimings m_timings;
+  RenderStats m_stats;
+
+  std::vector<std::vector<Triangle> > m_triangles;            /// per batch
+  std::vector<std::vector<std::vector<uint32_t> > > m_bins;   /// per batch, per tile
+  std::vector<FrameTimings> m_batchTimings;
+  std::vector<FrameTimings> m_tileTimings;
+  std::vector<RenderStats> m_batchStats;
+  std::vector<RenderStats> m_tileStats;
+
+};
+
+#endif //__RENDERER_HPP__
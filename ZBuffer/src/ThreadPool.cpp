@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include "ThreadPool.hpp"
+#include "Trace.hpp"
+
+// the pool and worker index of the current thread, if it is a worker
+static thread_local ThreadPool *t_pool = 0;
+static thread_local size_t t_workerIndex = 0;
+
+ThreadPool::ThreadPool(size_t numThreads)
+  : m_pending(0),
+    m_nextWorker(0),
+    m_quit(false)
+{
+  if ( numThreads == 0 )
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+  for ( size_t i=0; i < numThreads; i++ )
+    m_workers.push_back(new Worker());
+  for ( size_t i=0; i < numThreads; i++ )
+    m_threads.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_sleepMutex);
+    m_quit = true;
+  }
+  m_sleepCond.notify_all();
+  for ( size_t i=0; i < m_threads.size(); i++ )
+    m_threads[i].join();
+  for ( size_t i=0; i < m_workers.size(); i++ )
+    delete m_workers[i];
+}
+
+ThreadPool &ThreadPool::instance()
+{
+  static ThreadPool pool;
+  return pool;
+}
+
+size_t ThreadPool::numThreads() const
+{
+  return m_workers.size();
+}
+
+void ThreadPool::submit(const Task &task, Priority priority)
+{
+  // workers keep their own subtasks local, other threads spread round-robin
+  size_t index = (t_pool == this) ? t_workerIndex : m_nextWorker++ % m_workers.size();
+  // count the task before publishing it, a worker may pop and uncount it
+  // right away; a worker that sees the count before the push just retries
+  ++m_pending;
+  {
+    std::lock_guard<std::mutex> lock(m_workers[index]->mutex);
+    m_workers[index]->tasks[priority].push_back(task);
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_sleepMutex);
+  }
+  m_sleepCond.notify_one();
+}
+
+bool ThreadPool::popTask(size_t index, Task &task)
+{
+  const size_t n = m_workers.size();
+  for ( int p=0; p < NUM_PRIORITIES; p++ )
+  {
+    // own deque, newest first
+    {
+      Worker *w = m_workers[index];
+      std::lock_guard<std::mutex> lock(w->mutex);
+      if ( !w->tasks[p].empty() )
+      {
+        task = w->tasks[p].back();
+        w->tasks[p].pop_back();
+        --m_pending;
+        return true;
+      }
+    }
+    // steal the oldest task of another worker
+    for ( size_t k=1; k < n; k++ )
+    {
+      Worker *w = m_workers[(index+k) % n];
+      std::lock_guard<std::mutex> lock(w->mutex);
+      if ( !w->tasks[p].empty() )
+      {
+        task = w->tasks[p].front();
+        w->tasks[p].pop_front();
+        --m_pending;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void ThreadPool::workerLoop(size_t index)
+{
+  t_pool = this;
+  t_workerIndex = index;
+  char name[32];
+  snprintf(name, sizeof(name), "worker %lu", (unsigned long)index);
+  Trace::setThreadName(name);
+
+  for ( ;; )
+  {
+    Task task;
+    if ( popTask(index, task) )
+    {
+      task();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(m_sleepMutex);
+    if ( m_quit )
+      return;
+    m_sleepCond.wait(lock, [this] { return m_quit || m_pending > 0; });
+  }
+}
+
+void ThreadPool::parallelFor(size_t n, size_t grain, const RangeTask &fn, Priority priority)
+{
+  if ( n == 0 )
+    return;
+  grain = std::max<size_t>(1, grain);
+
+  struct State {
+    const RangeTask *fn;
+    size_t n, grain, chunks;
+    std::atomic<size_t> next;
+    std::atomic<size_t> done;
+    std::mutex mutex;
+    std::condition_variable cond;
+  };
+  std::shared_ptr<State> state = std::make_shared<State>();
+  state->fn = &fn;
+  state->n = n;
+  state->grain = grain;
+  state->chunks = (n + grain - 1) / grain;
+  state->next = 0;
+  state->done = 0;
+
+  // Helpers that start after all chunks are claimed return immediately and
+  // never touch fn, which only lives as long as this call.
+  std::function<void()> run = [state]() {
+    for ( ;; )
+    {
+      size_t c = state->next++;
+      if ( c >= state->chunks )
+        return;
+      size_t begin = c * state->grain;
+      (*state->fn)(begin, std::min(state->n, begin + state->grain));
+      if ( ++state->done == state->chunks )
+      {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->cond.notify_all();
+      }
+    }
+  };
+
+  size_t helpers = std::min(state->chunks - 1, m_workers.size());
+  for ( size_t i=0; i < helpers; i++ )
+    submit(run, priority);
+  run();
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->cond.wait(lock, [&state] { return state->done == state->chunks; });
+}
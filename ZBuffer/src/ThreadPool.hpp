@@ -0,0 +1,76 @@
+#ifndef __THREAD_POOL_HPP__
+#define __THREAD_POOL_HPP__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** \brief Process-wide work-stealing scheduler.
+ *
+ * Every worker owns one deque per priority. A worker pops its own tasks from
+ * the back and steals from the front of the other workers' deques, always
+ * looking for High priority work (the widget the user interacts with) on
+ * every worker before falling back to Normal priority work.
+ *
+ * Tasks may block on nested parallelFor() calls: the calling thread claims
+ * chunks itself, so nesting never deadlocks even when all workers are busy.
+ */
+class ThreadPool {
+public:
+  enum Priority {
+    High = 0,
+    Normal = 1,
+    NUM_PRIORITIES = 2
+  };
+
+  typedef std::function<void()> Task;
+  typedef std::function<void(size_t, size_t)> RangeTask;
+
+public:
+  /// \param numThreads number of workers, 0 means one per hardware thread
+  explicit ThreadPool(size_t numThreads = 0);
+  ~ThreadPool();
+
+  /// The pool shared by all widgets, loaders and tools of the process.
+  static ThreadPool &instance();
+
+public:
+  size_t numThreads() const;
+
+  /** \brief Queue a task; it runs on some worker at some later point.
+   */
+  void submit(const Task &task, Priority priority = Normal);
+
+  /** \brief Call fn(begin, end) over [0, n) in chunks of at most grain
+   * elements and return when all chunks are done.
+   *
+   * Chunks are claimed in increasing order, so callers writing results per
+   * chunk can merge them deterministically.
+   */
+  void parallelFor(size_t n, size_t grain, const RangeTask &fn, Priority priority = Normal);
+
+private:
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Task> tasks[NUM_PRIORITIES];
+  };
+
+  void workerLoop(size_t index);
+  bool popTask(size_t index, Task &task);
+
+private:
+  std::vector<Worker*> m_workers;
+  std::vector<std::thread> m_threads;
+  std::atomic<size_t> m_pending;      /// queued, not yet started tasks
+  std::atomic<size_t> m_nextWorker;   /// round-robin target for submit()
+  std::mutex m_sleepMutex;
+  std::condition_variable m_sleepCond;
+  bool m_quit;
+
+};
+
+#endif //__THREAD_POOL_HPP__
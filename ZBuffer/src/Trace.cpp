@@ -0,0 +1,129 @@
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+#include "Trace.hpp"
+
+std::atomic<bool> Trace::s_recording(false);
+
+/// Events per thread kept until the next start(); later ones are dropped.
+static const size_t MAX_EVENTS = 1 << 20;
+
+struct TraceEvent {
+  const char *name;
+  int widget;
+  int index;
+  int64_t begin;
+  int64_t end;
+};
+
+// Only the owning thread appends, so the mutex is uncontended except while
+// start() or write() walk the buffers.
+struct ThreadBuffer {
+  int tid;
+  std::string name;
+  std::mutex mutex;
+  std::vector<TraceEvent> events;
+  size_t dropped;
+};
+
+// Buffers outlive their threads: events of a finished thread still belong
+// in the trace. They are few and small, so they are never freed.
+static std::mutex g_registryMutex;
+static std::vector<ThreadBuffer*> g_buffers;
+static thread_local ThreadBuffer *t_buffer = 0;
+
+static ThreadBuffer &thread_buffer()
+{
+  if ( !t_buffer )
+  {
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+    t_buffer = new ThreadBuffer();
+    t_buffer->tid = int(g_buffers.size()) + 1;
+    t_buffer->dropped = 0;
+    g_buffers.push_back(t_buffer);
+  }
+  return *t_buffer;
+}
+
+int64_t Trace::now()
+{
+  typedef std::chrono::steady_clock Clock;
+  static const Clock::time_point epoch = Clock::now();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - epoch).count();
+}
+
+void Trace::start()
+{
+  now();      // pin the epoch before the first event
+  {
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+    for ( size_t i=0; i < g_buffers.size(); i++ )
+    {
+      std::lock_guard<std::mutex> bufferLock(g_buffers[i]->mutex);
+      g_buffers[i]->events.clear();
+      g_buffers[i]->dropped = 0;
+    }
+  }
+  s_recording = true;
+}
+
+void Trace::stop()
+{
+  s_recording = false;
+}
+
+void Trace::setThreadName(const std::string &name)
+{
+  ThreadBuffer &buffer = thread_buffer();
+  std::lock_guard<std::mutex> lock(buffer.mutex);
+  buffer.name = name;
+}
+
+void Trace::record(const char *name, int widget, int index, int64_t begin, int64_t end)
+{
+  ThreadBuffer &buffer = thread_buffer();
+  std::lock_guard<std::mutex> lock(buffer.mutex);
+  if ( buffer.events.size() >= MAX_EVENTS )
+  {
+    buffer.dropped++;
+    return;
+  }
+  TraceEvent event = { name, widget, index, begin, end };
+  buffer.events.push_back(event);
+}
+
+bool Trace::write(const char *filename)
+{
+  FILE *fp = fopen(filename, "w");
+  if ( !fp )
+    return false;
+
+  fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+  fprintf(fp, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"zbuffer\"}}");
+
+  std::lock_guard<std::mutex> lock(g_registryMutex);
+  for ( size_t i=0; i < g_buffers.size(); i++ )
+  {
+    ThreadBuffer &buffer = *g_buffers[i];
+    std::lock_guard<std::mutex> bufferLock(buffer.mutex);
+    fprintf(fp, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+                "\"args\": {\"name\": \"%s\"}}",
+            buffer.tid, buffer.name.empty() ? "thread" : buffer.name.c_str());
+    if ( buffer.dropped )
+      fprintf(fp, ",\n{\"name\": \"dropped %lu events\", \"ph\": \"i\", \"s\": \"t\", \"pid\": 1, "
+                  "\"tid\": %d, \"ts\": %.3f}",
+              (unsigned long)buffer.dropped, buffer.tid,
+              buffer.events.empty() ? 0.0 : buffer.events.back().end * 1e-3);
+    for ( size_t k=0; k < buffer.events.size(); k++ )
+    {
+      const TraceEvent &e = buffer.events[k];
+      fprintf(fp, ",\n{\"name\": \"%s\", \"cat\": \"pipeline\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+                  "\"ts\": %.3f, \"dur\": %.3f, \"args\": {\"widget\": %d, \"index\": %d}}",
+              e.name, buffer.tid, e.begin * 1e-3, (e.end - e.begin) * 1e-3, e.widget, e.index);
+    }
+  }
+  fprintf(fp, "\n]}\n");
+  bool ok = !ferror(fp);
+  return fclose(fp) == 0 && ok;
+}
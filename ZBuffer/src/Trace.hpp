@@ -0,0 +1,67 @@
+#ifndef __TRACE_HPP__
+#define __TRACE_HPP__
+
+#include <atomic>
+#include <string>
+#include <stdint.h>
+
+/** \brief Timeline of pipeline events for chrome://tracing and Perfetto.
+ *
+ * While recording, every TraceScope adds one complete event with its
+ * thread, widget and item index to a buffer owned by the calling thread;
+ * threads never contend on a shared lock. write() saves everything
+ * recorded since start() in the Chrome trace event JSON format.
+ *
+ * When not recording, a TraceScope costs one relaxed atomic load.
+ */
+class Trace {
+public:
+  /// Drop the events recorded so far and start recording.
+  static void start();
+  static void stop();
+  static bool recording() { return s_recording.load(std::memory_order_relaxed); }
+
+  /// \return false if the file cannot be written
+  static bool write(const char *filename);
+
+  /// Name shown for the calling thread, e.g. "gui" or "worker 3".
+  static void setThreadName(const std::string &name);
+
+  /// Nanoseconds on the trace clock.
+  static int64_t now();
+  static void record(const char *name, int widget, int index, int64_t begin, int64_t end);
+
+private:
+  static std::atomic<bool> s_recording;
+
+};
+
+/** \brief Records the lifetime of the object as an event while tracing.
+ *
+ * \param name static string, e.g. "raster"
+ * \param widget id of the widget the work is for, -1 for none
+ * \param index batch, tile or file index, -1 for none
+ */
+class TraceScope {
+public:
+  explicit TraceScope(const char *name, int widget=-1, int index=-1)
+    : m_name(Trace::recording() ? name : 0),
+      m_widget(widget),
+      m_index(index),
+      m_begin(m_name ? Trace::now() : 0)
+  {}
+  ~TraceScope()
+  {
+    if ( m_name )
+      Trace::record(m_name, m_widget, m_index, m_begin, Trace::now());
+  }
+
+private:
+  const char *m_name;
+  int m_widget;
+  int m_index;
+  int64_t m_begin;
+
+};
+
+#endif //__TRACE_HPP__
@@ -1,179 +1,378 @@
 #include <cmath>
+#include <algorithm>
 #include <QPainter>
 #include "ZBWidget.hpp"
 #include "Logger.hpp"
-#define M_PI 3.14159265
+#include "Trace.hpp"
 ZBWidget::ZBWidget(Model *model, QWidget *parent)
   : QWidget(parent),
     m_model(model),
-    m_cameraAngleX(-90.0f),
-    m_cameraAngleY(0.0f),
-    m_cameraDistance(2.0f)
+    m_buttons(0),
+    m_interacting(false),
+    m_dragged(false),
+    m_shadingMode(Renderer::Phong),
+    m_frameLevel(0),
+    m_frameValid(false),
+    m_jobValid(false),
+    m_inFlight(false),
+    m_generation(0),
+    m_hasJob(false),
+    m_jobScheduled(false),
+    m_quit(false),
+    m_hasResult(false),
+    m_resultMs(0.0),
+    m_refineTimer(new QTimer(this)),
+    m_frameBudgetMs(30),
+    m_refineDelayMs(150),
+    m_fps(0.0),
+    m_totalFrames(0),
+    m_logFrames(0),
+    m_logTimer(new QTimer(this)),
+    m_showTimings(false)
 {
+  for ( int i=0; i < NUM_LEVELS; i++ )
+    m_levelMs[i] = -1.0;
+
+  m_refineTimer->setSingleShot(true);
+  m_refineTimer->setInterval(m_refineDelayMs);
+  connect(m_refineTimer, SIGNAL(timeout()), this, SLOT(refine()));
   connect(this, SIGNAL(repaintNeeded()), this, SLOT(update()));
+  m_clock.start();
+
+  connect(m_logTimer, SIGNAL(timeout()), this, SLOT(logTimings()));
+  m_logTimer->start(10000);
+
+  setFocusPolicy(Qt::ClickFocus);
+
+  static std::atomic<int> nextId(0);
+  m_id = nextId++;
+  m_renderer.setTraceId(m_id);
 }
 
 ZBWidget::~ZBWidget()
 {
+  // abort the frame in flight and wait for the pool task to let go of us
+  std::unique_lock<std::mutex> lock(m_renderMutex);
+  m_quit = true;
+  ++m_generation;
+  m_renderCond.wait(lock, [this] { return !m_jobScheduled; });
 }
 
-// https://www.scratchapixel.com/lessons/mathematics-physics-for-computer-graphics/lookat-function
-
-ZBWidget::Matrix4 ZBWidget::lookAt(float eye_x, float eye_y, float eye_z,
-                                   float center_x, float center_y, float center_z,
-                                   float up_x, float up_y, float up_z)
+void ZBWidget::setModel(Model *model)
 {
-  Vector3 eye(eye_x, eye_y, eye_z);
-  Vector3 center(center_x, center_y, center_z);
-  Vector3 up(up_x, up_y, up_z);
-  Vector3 f = (center - eye).normalized();      // -forward
-  Vector3 s = f.cross(up).normalized();         // right
-  Vector3 u = s.cross(f).normalized();
+  // no render task holds the old model: jobs are only submitted with one
+  ASSERT_MSG(!m_model || !m_jobValid, "ZBWidget: the model can only be set once");
+  m_model = model;
+  update();
+}
 
-  Matrix4 result(Matrix4::Identity());
-  result(0, 0) = s.x();
-  result(0, 1) = s.y();
-  result(0, 2) = s.z();
-  result(1, 0) = u.x();
-  result(1, 1) = u.y();
-  result(1, 2) = u.z();
-  result(2, 0) = -f.x();
-  result(2, 1) = -f.y();
-  result(2, 2) = -f.z();
-  result(0, 3) = -s.dot(eye);
-  result(1, 3) = -u.dot(eye);
-  result(2, 3) = f.dot(eye);
-  return result;
+void ZBWidget::setCamera(float angleX, float angleY, float distance)
+{
+  m_camera.set(angleX, angleY, distance);
+  emit repaintNeeded();
 }
 
-ZBWidget::Matrix4 ZBWidget::perspective(float fov, float aspect, float near, float far)
+void ZBWidget::setFrameBudget(int ms)
 {
-  ASSERT(aspect!=0.0f);
-  ASSERT(near!=far);
+  m_frameBudgetMs = std::max(1, ms);
+}
 
-  // convert fov from degree to radians
-  fov *= (M_PI / 180.0f);
+void ZBWidget::setRefineDelay(int ms)
+{
+  m_refineDelayMs = std::max(0, ms);
+  m_refineTimer->setInterval(m_refineDelayMs);
+}
 
-  float tanHalfFov = std::tan(fov/2);
+void ZBWidget::setTimingsOverlay(bool enabled)
+{
+  m_showTimings = enabled;
+  update();
+}
 
-  Matrix4 result(Matrix4::Zero());
-  result(0, 0) = 1.0f / (aspect * tanHalfFov);
-  result(1, 1) = 1.0f / tanHalfFov;
-  result(2, 2) = - (far + near) / (far - near);
-  result(3, 2) = -1.0f;
-  result(2, 3) = (-2.0f * far * near) / (far - near);
-  return result;
+void ZBWidget::setTimingsLogInterval(int ms)
+{
+  if ( ms > 0 )
+    m_logTimer->start(ms);
+  else
+    m_logTimer->stop();
 }
 
-ZBWidget::Matrix4 ZBWidget::rotateX(float degree)
+void ZBWidget::setShadingMode(Renderer::ShadingMode mode)
 {
-  float radians = degree * (M_PI / 180.0f);
-  float sinphi = std::sin(radians);
-  float cosphi = std::cos(radians);
+  m_shadingMode = mode;
+  update();
+}
 
-  Matrix4 result(Matrix4::Zero());
-  result(0, 0) = 1.0f;
-  result(1, 1) = cosphi;
-  result(1, 2) = -sinphi;
-  result(2, 1) = sinphi;
-  result(2, 2) = cosphi;
-  result(3, 3) = 1.0f;
-  return result;
+void ZBWidget::logTimings()
+{
+  if ( m_logFrames == 0 )
+    return;
+  INFO("%s: %d frames, per frame: %s", m_model->filename().c_str(), m_logFrames,
+       (m_logTimings / m_logFrames).toString().c_str());
+  m_logTimings.reset();
+  m_logFrames = 0;
 }
 
-ZBWidget::Matrix4 ZBWidget::rotateY(float degree)
+bool ZBWidget::FrameKey::operator==(const FrameKey &other) const
 {
-  float radians = degree * (M_PI / 180.0f);
-  float sinphi = std::sin(radians);
-  float cosphi = std::cos(radians);
+  return camera == other.camera
+      && width == other.width
+      && height == other.height
+      && modelVersion == other.modelVersion
+      && shadingMode == other.shadingMode;
+}
 
-  Matrix4 result(Matrix4::Zero());
-  result(0, 0) = cosphi;
-  result(0, 2) = sinphi;
-  result(1, 1) = 1.0f;
-  result(2, 0) = -sinphi;
-  result(2, 2) = cosphi;
-  result(3, 3) = 1.0f;
-  return result;
+ZBWidget::FrameKey ZBWidget::currentFrameKey() const
+{
+  FrameKey key;
+  key.camera = m_camera;
+  key.width = this->width();
+  key.height = this->height();
+  key.modelVersion = m_model ? m_model->version() : 0;
+  key.shadingMode = m_shadingMode;
+  return key;
 }
 
 void ZBWidget::paintEvent(QPaintEvent *event)
 {
-  ASSERT_MSG(m_model, "ZBWidget: failed to load model!");
+  TraceScope trace("paint", m_id);
+
+  if ( !m_model )
+  {
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::darkGray);
+    painter.setPen(Qt::yellow);
+    painter.drawText(rect(), Qt::AlignCenter, "loading...");
+    return;
+  }
+
+  // Expose events, focus changes and relayouts of the other widgets land
+  // here as well; only request a frame when something the image depends on
+  // changed and it is neither shown nor already being rendered.
+  //
+  // While dragging, at most one frame is in flight: intermediate camera
+  // states are dropped and frameReady() repaints with the newest one.
+  // Refinements and programmatic changes are superseded instead.
+  const FrameKey key = currentFrameKey();
+  if ( (!m_frameValid || key != m_frameKey)
+    && (!m_jobValid || key != m_lastJob.key)
+    && !(m_inFlight && m_interacting && !m_lastJob.refinement) )
+  {
+    submit(key, previewLevel(), false);
+  }
+
   QPainter painter(this);
+  double presentMs = 0.0;
+  {
+    ScopedTimer timer(presentMs);
+    if ( !m_frameValid )
+    {
+      painter.fillRect(rect(), Qt::darkGray);
+      if ( !m_model->resident() )
+      {
+        painter.setPen(Qt::yellow);
+        painter.drawText(rect(), Qt::AlignCenter, "loading...");
+      }
+    }
+    else if ( m_frameLevel == 0 && m_frame.size() == size() )
+      painter.drawImage(event->rect(), m_frame, event->rect());
+    else
+      painter.drawImage(rect(), m_frame);         // upscale the preview / stale size
+  }
+  m_frameTimings.ms[FrameTimings::Present] += presentMs;
+  m_totalTimings.ms[FrameTimings::Present] += presentMs;
+  m_logTimings.ms[FrameTimings::Present] += presentMs;
+
+  painter.setPen(Qt::yellow);
+  painter.drawText(5, 15, QString::number(m_fps, 'f', 1) + " fps");
+  if ( m_frameValid && m_frameKey.shadingMode != Renderer::Phong )
+    painter.drawText(80, 15, QString(Renderer::name(m_frameKey.shadingMode)));
+  if ( m_showTimings )
+  {
+    for ( int i=0; i < FrameTimings::NUM_STAGES; i++ )
+    {
+      FrameTimings::Stage stage = FrameTimings::Stage(i);
+      painter.drawText(5, 30 + 15*i, QString(FrameTimings::name(stage)) + " "
+                       + QString::number(m_frameTimings.ms[i], 'f', 2) + " ms");
+    }
+    int y = 30 + 15*FrameTimings::NUM_STAGES;
+    painter.drawText(5, y, QString("wall ") + QString::number(m_frameTimings.wallMs, 'f', 2) + " ms");
+    const RenderStats &stats = m_frameStats;
+    painter.drawText(5, y += 20, QString("tris ") + QString::number(stats.trianglesRasterized)
+                     + " / " + QString::number(stats.trianglesSubmitted)
+                     + " (frustum " + QString::number(stats.trianglesFrustumCulled)
+                     + ", back " + QString::number(stats.trianglesBackfaceCulled) + ")");
+    painter.drawText(5, y += 15, QString("frags ") + QString::number(stats.fragments)
+                     + " (pass " + QString::number(stats.depthPassed)
+                     + ", fail " + QString::number(stats.depthFailed) + ")");
+    painter.drawText(5, y += 15, QString("shaded ") + QString::number(stats.shaded));
+    painter.drawText(5, y += 15, QString("depth complexity ")
+                     + QString::number(stats.averageDepthComplexity(), 'f', 2)
+                     + " avg, " + QString::number(stats.maxDepthComplexity) + " max");
+  }
+}
 
-  int width = this->width();
-  int height = this->height();
+void ZBWidget::refine()
+{
+  if ( !m_frameValid || m_frameLevel == 0 )
+    return;
+  if ( currentFrameKey() != m_frameKey )
+    return;                     // camera moved again, paintEvent takes over
 
-  QImage img(width, height, QImage::Format_ARGB32);
-  img.fill(Qt::darkGray);
+  submit(m_frameKey, 0, true);
+}
 
-  Eigen::MatrixXd zbuffer(width, height);
-  zbuffer.fill(1.0);
+int ZBWidget::previewLevel() const
+{
+  // Pick the finest level that fits the budget. Levels that have never been
+  // rendered are extrapolated from full resolution by their pixel count.
+  for ( int level=0; level < NUM_LEVELS; level++ )
+  {
+    double ms = m_levelMs[level];
+    if ( ms < 0 && m_levelMs[0] >= 0 )
+      ms = m_levelMs[0] / double(1 << (2*level));
+    if ( ms >= 0 && ms <= m_frameBudgetMs )
+      return level;
+  }
+  return NUM_LEVELS-1;
+}
+
+void ZBWidget::submit(const FrameKey &key, int level, bool refinement)
+{
+  // the widget being dragged preempts background refreshes of the others
+  const ThreadPool::Priority priority = m_interacting ? ThreadPool::High : ThreadPool::Normal;
 
-  std::vector<QRgb*> img_data(height);
-  for ( int i=0; i < height; i++ )
+  bool schedule;
   {
-    img_data[i] = (QRgb*)img.scanLine(i);
+    std::lock_guard<std::mutex> lock(m_renderMutex);
+    m_job.key = key;
+    m_job.level = level;
+    m_job.generation = ++m_generation;  // supersedes the frame in flight
+    m_job.priority = priority;
+    m_job.refinement = refinement;
+    m_hasJob = true;
+    m_lastJob = m_job;
+    m_jobValid = true;
+    m_inFlight = true;
+    schedule = !m_jobScheduled;
+    m_jobScheduled = true;
   }
+  if ( schedule )
+    ThreadPool::instance().submit([this] { renderJobs(); }, priority);
+}
 
-#if 0
-  for ( int i=0; i < height; i++ )
-    for ( int j=0; j < width; j++ )
+void ZBWidget::renderJobs()
+{
+  for ( ;; )
+  {
+    RenderJob job;
     {
-      double d = std::sqrt((i-height/2)*(i-height/2)+(j-width/2)*(j-width/2));
-      if ( d < std::min(height/2, width/2) )
+      std::lock_guard<std::mutex> lock(m_renderMutex);
+      if ( !m_hasJob || m_quit )
       {
-        img_data[i][j] = 0xffff0000;
+        m_jobScheduled = false;
+        m_renderCond.notify_all();
+        return;
       }
+      job = m_job;
+      m_hasJob = false;
     }
-#endif
-
-#if 1
-  /* This is how our algorithms work:
-   * 0. Setup model matrix
-   * 1. Setup view matrix (camera)
-   * 2. Setup projection matrix
-   * 3. Find out all triangles in the viewing frustum
-   * 4. Filter out all triangles facing backward to camera
-   * 5. Rasterize each triangle into pixels
-   * 6. Set each pixel of the image to its nearest triangle pixel's color
-   */
-  Matrix4 transform(Matrix4::Identity());
-  transform *= perspective(60.0f, (float)width/height, 1.0f, 1000.0f);
-  transform *= lookAt(0.0f, 0.0f, m_cameraDistance, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f);
-  transform *= rotateX(m_cameraAngleX);
-  transform *= rotateY(m_cameraAngleY);
-
-  std::vector<Triangle> triangles;
-  m_model->getTriangles(triangles, transform);
-
-  for ( size_t i=0; i < triangles.size(); i++ )
-  {
-    std::vector<Pixel> pixels;
-    triangles[i].raster(pixels, width, height);     // get all pixels in discrete coordinates
 
-    for ( size_t j=0; j < pixels.size(); j++ )
+    QElapsedTimer timer;
+    timer.start();
+
+    const unsigned generation = job.generation;
+    FrameBuffer fb(std::max(1, job.key.width >> job.level),
+                   std::max(1, job.key.height >> job.level));
+    m_renderer.setPriority(job.priority);
+    m_renderer.setShadingMode(job.key.shadingMode);
+    m_model->acquire();         // loads a lazy model on its first frame
+    const bool rendered = m_renderer.render(*m_model, job.key.camera, fb,
+                                            [this, generation] { return generation != m_generation; });
+    m_model->release();
+    if ( !rendered )
+      continue;                 // superseded by a newer camera state
+
     {
-      const Pixel &p = pixels[j];
-      if ( p.x < 0 || p.x >= width
-        || p.y < 0 || p.y >= height )
+      std::lock_guard<std::mutex> lock(m_renderMutex);
+      if ( job.generation != m_generation )
         continue;
-
-      float depth = triangles[i].getDepth(p);       // we get depth of a pixel using barycentric coordinates
-      if ( depth < zbuffer(p.x, p.y) )
-      {
-        zbuffer(p.x, p.y) = depth;
-        img_data[height-p.y-1][p.x] = triangles[i].getColor(p);
-      }
+      std::swap(m_result, fb);
+      m_resultTimings = m_renderer.timings();
+      m_resultStats = m_renderer.stats();
+      m_resultJob = job;
+      m_resultMs = timer.nsecsElapsed() * 1e-6;
+      m_hasResult = true;
     }
+    QMetaObject::invokeMethod(this, "frameReady", Qt::QueuedConnection);
   }
-#endif
+}
 
-  painter.drawImage(QPoint(), img);
+void ZBWidget::frameReady()
+{
+  TraceScope trace("frame ready", m_id);
+  RenderJob job;
+  {
+    std::lock_guard<std::mutex> lock(m_renderMutex);
+    if ( !m_hasResult )
+      return;
+    m_frame = QImage();
+    std::swap(m_frameBuffer, m_result);
+    job = m_resultJob;
+    m_levelMs[job.level] = m_resultMs;
+    m_frameTimings = m_resultTimings;
+    m_frameStats = m_resultStats;
+    m_hasResult = false;
+  }
+  m_totalTimings += m_frameTimings;
+  m_totalFrames++;
+  m_logTimings += m_frameTimings;
+  m_logFrames++;
+  m_frame = QImage((const uchar*)m_frameBuffer.pixels(), m_frameBuffer.width(),
+                   m_frameBuffer.height(), 4*m_frameBuffer.width(), QImage::Format_ARGB32);
+  m_frameKey = job.key;
+  m_frameLevel = job.level;
+  m_frameValid = true;
+  if ( job.generation == m_lastJob.generation )
+    m_inFlight = false;
+
+  const qint64 now = m_clock.elapsed();
+  m_frameTimes.push_back(now);
+  while ( m_frameTimes.front() < now - 1000 )
+    m_frameTimes.pop_front();
+  if ( m_frameTimes.size() > 1 && m_frameTimes.back() > m_frameTimes.front() )
+    m_fps = (m_frameTimes.size()-1) * 1000.0 / (m_frameTimes.back() - m_frameTimes.front());
+
+  // the interaction ends with the full resolution frame after the release
+  if ( m_frameLevel == 0 && !m_buttons )
+    m_interacting = false;
+
+  if ( m_frameLevel > 0 )
+    m_refineTimer->start();       // restarted on every preview, fires once idle
+  update();
+}
 
+void ZBWidget::drag(const QPoint &pos)
+{
+  float angleX = m_camera.angleX();
+  float angleY = m_camera.angleY();
+  float distance = m_camera.distance();
+  if ( m_buttons & Qt::LeftButton )
+  {
+    angleY += (pos.x()-m_lastPos.x());
+    angleX += (pos.y()-m_lastPos.y());
+  }
+  else if ( m_buttons & Qt::RightButton )
+  {
+    distance -= (pos.y()-m_lastPos.y()) * 0.02f;
+  }
+  m_lastPos = pos;
 
+  if ( Camera(angleX, angleY, distance) == m_camera )
+    return;
 
+  m_dragged = true;
+  setCamera(angleX, angleY, distance);
 }
 
 void ZBWidget::mouseMoveEvent(QMouseEvent *event)
@@ -181,36 +380,37 @@ void ZBWidget::mouseMoveEvent(QMouseEvent *event)
   if ( event->buttons() )
   {
     m_buttons = event->buttons();
+    drag(event->pos());
   }
 }
 
+void ZBWidget::keyPressEvent(QKeyEvent *event)
+{
+  if ( event->key() == Qt::Key_T )
+    setTimingsOverlay(!m_showTimings);
+  else if ( event->key() == Qt::Key_H )
+    setShadingMode(Renderer::ShadingMode((m_shadingMode + 1) % Renderer::NUM_SHADING_MODES));
+  else
+    QWidget::keyPressEvent(event);
+}
+
 void ZBWidget::mousePressEvent(QMouseEvent *event)
 {
   m_lastPos = event->pos();
-  INFO("press pos = (%d, %d)", m_lastPos.x(), m_lastPos.y());
+  m_buttons = event->buttons();
+  m_interacting = true;
+  m_dragged = false;
+  INFO_EVERY(250, "press pos = (%d, %d)", m_lastPos.x(), m_lastPos.y());
 }
 
 void ZBWidget::mouseReleaseEvent(QMouseEvent *event)
 {
   const QPoint &pos = event->pos();
-  INFO("release pos = (%d, %d)", pos.x(), pos.y());
+  INFO_EVERY(250, "release pos = (%d, %d)", pos.x(), pos.y());
 
-  if ( m_buttons & Qt::LeftButton )
-  {
-    m_cameraAngleY += (pos.x()-m_lastPos.x());
-    m_cameraAngleX += (pos.y()-m_lastPos.y());
-  }
-  else if ( m_buttons & Qt::RightButton )
-  {
-    m_cameraDistance -= (pos.y()-m_lastPos.y()) * 0.02f;
-  }
+  drag(pos);
   m_buttons = 0;
 
-  if ( m_lastPos.x() == pos.x()
-    && m_lastPos.y() == pos.y() )
-    return;
-
-  emit repaintNeeded();
-  INFO("processing...");
+  if ( !m_dragged )
+    m_interacting = false;
 }
-
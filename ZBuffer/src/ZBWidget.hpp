@@ -4,41 +4,196 @@
 #include <QWidget>
 #include <QPaintEvent>
 #include <QMouseEvent>
-#include <Eigen/Eigen>
+#include <QKeyEvent>
+#include <QImage>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include "Model.hpp"
+#include "Camera.hpp"
+#include "FrameBuffer.hpp"
+#include "FrameTimings.hpp"
+#include "RenderStats.hpp"
+#include "Renderer.hpp"
+#include "ThreadPool.hpp"
 
-class ZBWidget : public QWidget, EigenTypes {
+/** \brief Qt front end of the rendering core.
+ *
+ * Maps mouse input to the Camera, schedules Renderer jobs on the shared
+ * ThreadPool and blits the resulting FrameBuffer; all geometry work happens
+ * in the core library.
+ */
+class ZBWidget : public QWidget {
 
 Q_OBJECT
 
 public:
+  /// \param model shown model, or null for a placeholder until setModel()
   ZBWidget(Model *model, QWidget *parent=0);
   virtual ~ZBWidget();
 
 public:
-  static Matrix4 lookAt(float eye_x, float eye_y, float eye_z,
-                        float center_x, float center_y, float center_z,
-                        float up_x, float up_y, float up_z);
-  static Matrix4 perspective(float fov, float aspect, float near, float far);
-  static Matrix4 rotateX(float degree);
-  static Matrix4 rotateY(float degree);
+  /// Number of preview levels; level i renders at 1/(2^i) of the width and height.
+  static const int NUM_LEVELS = 3;
+
+  /** \brief Show model, which must outlive the widget; only a placeholder
+   * is drawn while there is none.
+   *
+   * The model is acquired for every frame, so a Lazy model loads with its
+   * first frame and may be evicted while the widget just shows its image.
+   */
+  void setModel(Model *model);
+  Model *model() const { return m_model; }
+
+  /** \brief Move the camera; the widget repaints with a preview first.
+   */
+  void setCamera(float angleX, float angleY, float distance);
+  const Camera &camera() const { return m_camera; }
+
+  /** \brief Time a frame may take while the camera is changing.
+   *
+   * The coarsest preview level whose last measured (or extrapolated) render
+   * time fits in the budget is shown first; full resolution follows once the
+   * camera has been idle for refineDelay() milliseconds.
+   */
+  void setFrameBudget(int ms);
+  int frameBudget() const { return m_frameBudgetMs; }
+  void setRefineDelay(int ms);
+  int refineDelay() const { return m_refineDelayMs; }
+
+  /// Id of the widget in Trace events, unique within the process.
+  int id() const { return m_id; }
+
+  /// Frames delivered per second, measured over the last second of rendering.
+  double fps() const { return m_fps; }
+
+  /// Stage times of the frame on screen, including presenting it.
+  const FrameTimings &frameTimings() const { return m_frameTimings; }
+  /// Stage times summed over all frames delivered so far, and their number.
+  const FrameTimings &totalTimings() const { return m_totalTimings; }
+  int totalFrames() const { return m_totalFrames; }
+  /// Pipeline counters of the frame on screen.
+  const RenderStats &frameStats() const { return m_frameStats; }
+
+  /// Draw frameTimings() and frameStats() over the image; toggled with the T key.
+  void setTimingsOverlay(bool enabled);
+  bool timingsOverlay() const { return m_showTimings; }
+
+  /// Interval of the per-widget timing log line, 0 disables it.
+  void setTimingsLogInterval(int ms);
+
+  /// Show the model or an overdraw / tile cost heatmap; cycled with the H key.
+  void setShadingMode(Renderer::ShadingMode mode);
+  Renderer::ShadingMode shadingMode() const { return m_shadingMode; }
+
+protected:
+  /** \brief Everything a rendered frame depends on.
+   *
+   * paintEvent only re-renders when the key differs from the cached one, so
+   * expose events and relayouts just blit the last image.
+   */
+  struct FrameKey {
+    Camera camera;
+    int width;
+    int height;
+    uint64_t modelVersion;
+    Renderer::ShadingMode shadingMode;
+
+    bool operator==(const FrameKey &other) const;
+    bool operator!=(const FrameKey &other) const { return !(*this == other); }
+  };
+
+  /** \brief A frame requested from the pool.
+   *
+   * Submitting a new job bumps m_generation, which the renderer polls
+   * between triangle batches to drop the superseded frame.
+   */
+  struct RenderJob {
+    FrameKey key;
+    int level;
+    unsigned generation;
+    ThreadPool::Priority priority;
+    bool refinement;        /// full resolution pass after the camera settled
+  };
+
+  FrameKey currentFrameKey() const;
+  void submit(const FrameKey &key, int level, bool refinement);
+  void drag(const QPoint &pos);
+  void renderJobs();
+  int previewLevel() const;
 
 protected:
   virtual void paintEvent(QPaintEvent *event);
   virtual void mouseMoveEvent(QMouseEvent *event);
   virtual void mousePressEvent(QMouseEvent *event);
   virtual void mouseReleaseEvent(QMouseEvent *event);
+  virtual void keyPressEvent(QKeyEvent *event);
 
 signals:
   void repaintNeeded();
 
+private slots:
+  void refine();
+  void frameReady();
+  void logTimings();
+
 private:
+  int m_id;
   Model *m_model;
   QPoint m_lastPos;
   int m_buttons;
-  float m_cameraAngleX;
-  float m_cameraAngleY;
-  float m_cameraDistance;
+  bool m_interacting;       /// dragged and not yet refined, renders at high priority
+  bool m_dragged;           /// the camera moved since the last mouse press
+  Camera m_camera;
+  Renderer::ShadingMode m_shadingMode;
+
+  FrameBuffer m_frameBuffer;  /// last rendered image
+  QImage m_frame;           /// view of m_frameBuffer for QPainter
+  FrameKey m_frameKey;      /// state m_frame was rendered with
+  int m_frameLevel;         /// preview level of m_frame, 0 is full resolution
+  bool m_frameValid;
+
+  bool m_jobValid;
+  RenderJob m_lastJob;      /// last job submitted from the GUI thread
+  bool m_inFlight;          /// m_lastJob has not been delivered yet
+
+  // job/result slots shared between the GUI thread and the pool task
+  // rendering this widget; at most one such task exists at a time
+  std::mutex m_renderMutex;
+  std::condition_variable m_renderCond;
+  std::atomic<unsigned> m_generation;
+  bool m_hasJob;
+  bool m_jobScheduled;
+  bool m_quit;
+  RenderJob m_job;
+  bool m_hasResult;
+  RenderJob m_resultJob;
+  FrameBuffer m_result;
+  FrameTimings m_resultTimings;
+  RenderStats m_resultStats;
+  double m_resultMs;
+  Renderer m_renderer;      /// only used by the pool task
+
+  QTimer *m_refineTimer;
+  int m_frameBudgetMs;
+  int m_refineDelayMs;
+  double m_levelMs[NUM_LEVELS];   /// last render time of each level, <0 if unknown
+
+  QElapsedTimer m_clock;
+  std::deque<qint64> m_frameTimes; /// delivery times of the frames of the last second
+  double m_fps;
+
+  FrameTimings m_frameTimings;
+  RenderStats m_frameStats;
+  FrameTimings m_totalTimings;
+  int m_totalFrames;
+  FrameTimings m_logTimings;  /// sum since the last log line
+  int m_logFrames;
+  QTimer *m_logTimer;
+  bool m_showTimings;
 
 };
 
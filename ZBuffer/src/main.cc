@@ -1,17 +1,65 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <limits>
 #include <QApplication>
 #include "MainWindow.hpp"
+#include "MeshCache.hpp"
+#include "Logger.hpp"
+#include "Trace.hpp"
 #include <QGLFormat>
 
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+// a quarter of the physical memory, 0 (unlimited) if it cannot be found
+static size_t physical_memory_budget()
+{
+  unsigned long long bytes = 0;
+#ifdef _WIN32
+  MEMORYSTATUSEX status;
+  status.dwLength = sizeof(status);
+  if ( GlobalMemoryStatusEx(&status) )
+    bytes = status.ullTotalPhys;
+#else
+  const long pages = sysconf(_SC_PHYS_PAGES);
+  const long pageSize = sysconf(_SC_PAGESIZE);
+  if ( pages > 0 && pageSize > 0 )
+    bytes = (unsigned long long)pages * (unsigned long long)pageSize;
+#endif
+  return size_t(std::min(bytes / 4, (unsigned long long)std::numeric_limits<size_t>::max()));
+}
+
+// ZBUFFER_MEMORY_BUDGET_MB if set, 0 meaning unlimited, else a quarter of
+// the physical memory
+static size_t memory_budget()
+{
+  const char *value = getenv("ZBUFFER_MEMORY_BUDGET_MB");
+  if ( value && *value )
+  {
+    char *end;
+    const unsigned long long mb = strtoull(value, &end, 10);
+    if ( *end == '\0' && mb <= std::numeric_limits<size_t>::max() >> 20 )
+      return size_t(mb) << 20;
+    WARN("ignoring ZBUFFER_MEMORY_BUDGET_MB=%s, not a size in MB", value);
+  }
+  return physical_memory_budget();
+}
+
 int main(int argc, char * argv[]) {
 
   QApplication app(argc, argv);
+  Trace::setThreadName("gui");
 
   QGLFormat glf = QGLFormat::defaultFormat();
   glf.setSampleBuffers(true);
   glf.setSamples(4);
   QGLFormat::setDefaultFormat(glf);
-  std::vector<Model*> m_models;
+  std::vector<std::string> filenames;
   for (int i=1; i<7; ++i)
   {
       std::string s = "blue_blade/blue_blade";
@@ -21,10 +69,16 @@ int main(int argc, char * argv[]) {
       itoa(i,st,10);
       s+= st;
       s+=".obj";
-      m_models.push_back(new Model(s.c_str()));
+      filenames.push_back(s);
 
   }
-  MainWindow window(m_models);
+  // parse every model once, later launches map its cache file
+  MeshCache::setEnabled(true);
+
+  // geometry of the models in the grid; the least recently rendered ones
+  // are unloaded beyond this
+  Model::setMemoryBudget(memory_budget());
+  MainWindow window(filenames);
   window.show();
 
   return app.exec();
@@ -0,0 +1,121 @@
+#!/bin/sh
+# Image and frame time regression check of the renderer.
+#
+# Renders the reference models with fixed cameras, sizes and threads and
+# compares the frames against the images in ZBuffer/golden and the p50
+# frame times against the baseline_<size>.json files there, and renders
+# the files in ZBuffer/golden/cases with and without --cleanup. Fails if
+# any image differs, any run is slower than allowed, a case fails or a
+# reference is missing.
+#
+# Usage: ZBuffer/tools/check_bench.sh [path/to/zbuffer_bench]
+#   MAX_REGRESSION=PCT  allowed p50 slowdown; default the one recorded in
+#                       ZBuffer/golden/max_regression, else 10
+#
+# The references are committed; after an intended change to the images or
+# the speed, rewrite them from a trusted build with
+#
+#   ZBuffer/tools/check_bench.sh --update [path/to/zbuffer_bench]
+#
+# and review the changed files before committing them. The update times
+# every set twice and records twice the largest p50 difference between
+# the two runs, at least 10%, as the allowed slowdown.
+
+ROOT=$(cd "$(dirname "$0")/../.." && pwd)
+GOLDEN=ZBuffer/golden
+
+UPDATE=0
+if [ "$1" = "--update" ]; then
+  UPDATE=1
+  shift
+fi
+BENCH=${1:-$ROOT/zbuffer_bench}
+
+# models relative to the repository root, fixed settings; every model at
+# each size, all camera paths at the small one
+COMMON="--threads 1 --frames 24 --warmup 2"
+MODELS="bunny.obj dragon.obj blue_blade/blue_blade.obj
+        blue_blade/blue_blade01.obj blue_blade/blue_blade02.obj blue_blade/blue_blade03.obj
+        blue_blade/blue_blade04.obj blue_blade/blue_blade05.obj blue_blade/blue_blade06.obj
+        blue_blade/blue_blade07.obj"
+SETS="160x120 320x240"
+set_args() {
+  case $1 in
+    160x120) echo "--size 160x120 --path orbit --path tumble --path zoom" ;;
+    320x240) echo "--size 320x240 --path orbit" ;;
+  esac
+}
+
+# largest p50 difference in percent between the runs of two JSON results
+spread() {
+  awk '
+    function field(name,   s) {
+      if (!match($0, "\"" name "\": \"?[^,\"]*")) return ""
+      s = substr($0, RSTART, RLENGTH)
+      sub(/.*: "?/, "", s)
+      return s
+    }
+    /"model"/ {
+      key = field("model") " " field("width") " " field("height") " " field("path")
+      p = field("p50")
+      if (FILENAME == ARGV[1]) { base[key] = p; next }
+      if (key in base && base[key] > 0) {
+        d = 100 * (p - base[key]) / base[key]
+        if (d < 0) d = -d
+        if (d > max) max = d
+      }
+    }
+    END { printf "%d\n", max + 0.5 }' "$1" "$2"
+}
+
+cd "$ROOT" || exit 1
+if [ ! -x "$BENCH" ]; then
+  echo "check_bench: $BENCH not found, build zbuffer_bench.pro first" >&2
+  exit 1
+fi
+
+if [ $UPDATE = 1 ]; then
+  mkdir -p "$GOLDEN"
+  SECOND=$(mktemp) || exit 1
+  LIMIT=10
+  for SET in $SETS; do
+    "$BENCH" $COMMON $(set_args $SET) --golden "$GOLDEN" --update-golden $MODELS || exit 1
+    # time comparing runs, loading the references costs cache capacity
+    "$BENCH" $COMMON $(set_args $SET) --golden "$GOLDEN" --json "$GOLDEN/baseline_$SET.json" $MODELS || exit 1
+    "$BENCH" $COMMON $(set_args $SET) --golden "$GOLDEN" --json "$SECOND" $MODELS >/dev/null || exit 1
+    SPREAD=$(spread "$GOLDEN/baseline_$SET.json" "$SECOND")
+    echo "check_bench: $SET p50 differs by up to $SPREAD% between two runs"
+    [ $((2 * SPREAD)) -gt $LIMIT ] && LIMIT=$((2 * SPREAD))
+  done
+  rm -f "$SECOND"
+  echo $LIMIT > "$GOLDEN/max_regression"
+  echo "check_bench: allowed slowdown $LIMIT%"
+  exit 0
+fi
+
+for SET in $SETS; do
+  if [ ! -f "$GOLDEN/baseline_$SET.json" ] || [ -z "$(ls "$GOLDEN"/*_${SET}_*.ppm 2>/dev/null)" ]; then
+    echo "check_bench: $SET references missing in $GOLDEN" >&2
+    exit 1
+  fi
+done
+
+# files that once broke loading must render, raw and cleaned up
+for CASE in "$GOLDEN"/cases/*; do
+  for CLEANUP in "" --cleanup; do
+    if ! "$BENCH" --threads 1 --frames 1 --warmup 0 --size 32x24 --path orbit $CLEANUP "$CASE" >/dev/null; then
+      echo "check_bench: $CASE $CLEANUP failed to render" >&2
+      exit 1
+    fi
+  done
+done
+
+if [ -z "$MAX_REGRESSION" ]; then
+  MAX_REGRESSION=$(cat "$GOLDEN/max_regression" 2>/dev/null || echo 10)
+fi
+STATUS=0
+for SET in $SETS; do
+  "$BENCH" $COMMON $(set_args $SET) --golden "$GOLDEN" --baseline "$GOLDEN/baseline_$SET.json" \
+           --max-regression "$MAX_REGRESSION" $MODELS || STATUS=1
+done
+exit $STATUS
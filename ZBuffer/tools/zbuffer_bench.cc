@@ -0,0 +1,525 @@
+// Headless rendering benchmark.
+//
+// Loads OBJ files, renders them off-screen along scripted camera paths and
+// reports per-frame timings and throughput as text and, optionally, JSON.
+// Camera paths are fixed functions of the frame index and the renderer is
+// deterministic, so the image checksum of a run only changes when the
+// rendered pixels do.
+//
+// With --golden and --baseline the same runs double as a regression check:
+// frames at fixed points of every path are compared against reference
+// images, and the median frame time against a previous --json result. The
+// exit status is non-zero if either check fails, so
+//
+//   zbuffer_bench --golden golden --baseline golden/baseline.json
+//
+// proves images and speed together after a change to the renderer. Missing
+// reference images and runs without a baseline entry fail as well. The
+// references come from a trusted build:
+//
+//   zbuffer_bench --golden golden --update-golden --json golden/baseline.json
+//
+// tools/check_bench.sh runs the check against the references committed in
+// golden/ with fixed models, sizes and threads.
+//
+// Usage: zbuffer_bench [options] [model.obj ...]
+//   --size WxH     render resolution, may be repeated
+//                  (default 320x240, 640x480 and 1280x720)
+//   --frames N     frames per camera path (default 36)
+//   --warmup N     untimed frames before each run (default 2)
+//   --threads N    worker threads (default one per hardware thread)
+//   --path NAME    orbit, tumble or zoom, may be repeated (default all)
+//   --cull         enable back-face culling
+//   --cleanup      run MeshCleanup on the models after parsing
+//   --cleanup-epsilon E  sliver threshold of the cleanup, implies --cleanup
+//   --cache-dir DIR  keep MeshCache files in DIR; without it every run parses
+//   --json FILE    also write the results to FILE as JSON
+//   --trace FILE   write a Chrome trace of all runs to FILE
+//   --golden DIR   compare frames against the reference images in DIR
+//   --update-golden  write the reference images to DIR instead
+//   --tolerance N  largest per-channel difference of a matching pixel (default 2)
+//   --max-bad F    fraction of pixels allowed beyond the tolerance (default 0.001)
+//   --baseline FILE  compare the p50 frame times against FILE from --json
+//   --max-regression PCT  allowed p50 slowdown over the baseline (default 10)
+//
+// Without model arguments, bunny.obj, dragon.obj and blue_blade/*.obj are
+// loaded relative to the working directory.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "Model.hpp"
+#include "MeshCleanup.hpp"
+#include "MeshCache.hpp"
+#include "Camera.hpp"
+#include "FrameBuffer.hpp"
+#include "FrameTimings.hpp"
+#include "RenderStats.hpp"
+#include "Renderer.hpp"
+#include "ImageIO.hpp"
+#include "Trace.hpp"
+#include "ThreadPool.hpp"
+#include "Logger.hpp"
+
+#ifndef M_PI
+#define M_PI 3.14159265
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsed_ms(Clock::time_point since)
+{
+  return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+}
+
+static const char *PATHS[] = { "orbit", "tumble", "zoom" };
+static const size_t NUM_PATHS = sizeof(PATHS) / sizeof(PATHS[0]);
+
+/// Camera of frame i out of n along the named path.
+static Camera camera_on_path(const std::string &path, int i, int n)
+{
+  double t = double(i) / n;
+  if ( path == "orbit" )
+    return Camera(-90.0f, float(360.0*t), 2.0f);
+  if ( path == "tumble" )
+    return Camera(float(-90.0 + 360.0*t), 30.0f, 2.0f);
+  // zoom: in to 1.25 and back out to 4
+  return Camera(-90.0f, 0.0f, float(1.25 + 2.75*(0.5 - 0.5*std::cos(2.0*M_PI*t))));
+}
+
+/// Nearest-rank percentile of sorted samples.
+static double percentile(const std::vector<double> &sorted, double p)
+{
+  size_t rank = size_t(std::ceil(p * sorted.size()));
+  return sorted[std::min(sorted.size(), std::max<size_t>(1, rank)) - 1];
+}
+
+struct Result {
+  std::string model;
+  size_t triangles;
+  double loadMs;
+  int width, height;
+  std::string path;
+  int frames;
+  double mean, p50, p95, p99, min, max;
+  double trianglesPerSec;
+  double fragmentsPerSec;
+  FrameTimings stages;      /// mean per frame
+  RenderStats stats;        /// summed over all frames
+  uint64_t checksum;
+};
+
+/// Frames of a path compared against reference images.
+static const int GOLDEN_FRAMES = 4;
+
+static bool is_golden_frame(int i, int frames)
+{
+  for ( int k=0; k < GOLDEN_FRAMES; k++ )
+    if ( i == k * frames / GOLDEN_FRAMES )
+      return true;
+  return false;
+}
+
+/// DIR/<model>_<path>_<W>x<H>_<frame>.ppm, with the model path flattened.
+static std::string golden_file(const std::string &dir, const std::string &model,
+                               const std::string &path, int width, int height, int frame)
+{
+  std::string name = model;
+  for ( size_t i=0; i < name.size(); i++ )
+    if ( name[i] == '/' || name[i] == '\\' || name[i] == '.' || name[i] == ':' )
+      name[i] = '_';
+  char suffix[64];
+  sprintf(suffix, "_%dx%d_%02d.ppm", width, height, frame);
+  return dir + "/" + name + "_" + path + suffix;
+}
+
+/** \brief Number of pixels whose channels differ by more than tolerance,
+ * or -1 if the sizes differ.
+ */
+static long count_bad_pixels(const FrameBuffer &a, const FrameBuffer &b, int tolerance)
+{
+  if ( a.width() != b.width() || a.height() != b.height() )
+    return -1;
+  long bad = 0;
+  for ( size_t k=0; k < size_t(a.width())*a.height(); k++ )
+  {
+    const uint32_t p = a.pixels()[k], q = b.pixels()[k];
+    for ( int shift=0; shift < 24; shift += 8 )
+      if ( std::abs(int((p >> shift) & 0xff) - int((q >> shift) & 0xff)) > tolerance )
+      {
+        bad++;
+        break;
+      }
+  }
+  return bad;
+}
+
+/// A run of a --json result file, keyed like Result.
+struct Baseline {
+  std::string model, path;
+  int width, height;
+  double p50;
+};
+
+// value of "key": in a line of our own JSON output
+static const char *json_value(const char *line, const char *key)
+{
+  std::string pattern = std::string("\"") + key + "\": ";
+  const char *p = strstr(line, pattern.c_str());
+  return p ? p + pattern.size() : 0;
+}
+
+static std::string json_string(const char *line, const char *key)
+{
+  const char *p = json_value(line, key);
+  if ( !p || *p != '"' )
+    return std::string();
+  const char *end = strchr(p+1, '"');
+  return end ? std::string(p+1, end) : std::string();
+}
+
+/// Runs of a file written by --json; reads back only what the bench writes.
+static std::vector<Baseline> load_baseline(const char *filename, int &threads)
+{
+  std::vector<Baseline> runs;
+  FILE *fp = fopen(filename, "r");
+  ASSERT_MSG(fp, "cannot read %s", filename);
+  char line[4096];
+  threads = 0;
+  while ( fgets(line, sizeof(line), fp) )
+  {
+    const char *v;
+    if ( (v = json_value(line, "threads")) )
+      threads = atoi(v);
+    if ( !json_value(line, "model") || !json_value(line, "p50") )
+      continue;
+    Baseline b;
+    b.model = json_string(line, "model");
+    b.path = json_string(line, "path");
+    b.width = atoi(json_value(line, "width"));
+    b.height = atoi(json_value(line, "height"));
+    b.p50 = atof(json_value(line, "p50"));
+    runs.push_back(b);
+  }
+  fclose(fp);
+  return runs;
+}
+
+static void usage(const char *argv0)
+{
+  fprintf(stderr, "usage: %s [--size WxH]... [--frames N] [--warmup N] [--threads N]\n"
+                  "       [--path orbit|tumble|zoom]... [--cull] [--cleanup] [--cleanup-epsilon E]\n"
+                  "       [--cache-dir DIR] [--json FILE] [--trace FILE]\n"
+                  "       [--golden DIR [--update-golden] [--tolerance N] [--max-bad F]]\n"
+                  "       [--baseline FILE [--max-regression PCT]] [model.obj ...]\n", argv0);
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+  std::vector<std::string> models;
+  std::vector<std::pair<int, int> > sizes;
+  std::vector<std::string> paths;
+  int frames = 36;
+  int warmup = 2;
+  int threads = 0;
+  bool cull = false;
+  const char *json = 0;
+  const char *trace = 0;
+  const char *golden = 0;
+  bool updateGolden = false;
+  int tolerance = 2;
+  double maxBad = 0.001;
+  const char *baseline = 0;
+  double maxRegression = 10.0;
+
+  for ( int i=1; i < argc; i++ )
+  {
+    const char *arg = argv[i];
+    bool hasValue = (i+1 < argc);
+    if ( !strcmp(arg, "--size") && hasValue )
+    {
+      int w, h;
+      if ( sscanf(argv[++i], "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0 )
+        usage(argv[0]);
+      sizes.push_back(std::make_pair(w, h));
+    }
+    else if ( !strcmp(arg, "--frames") && hasValue )
+      frames = std::max(1, atoi(argv[++i]));
+    else if ( !strcmp(arg, "--warmup") && hasValue )
+      warmup = std::max(0, atoi(argv[++i]));
+    else if ( !strcmp(arg, "--threads") && hasValue )
+      threads = std::max(1, atoi(argv[++i]));
+    else if ( !strcmp(arg, "--path") && hasValue )
+    {
+      paths.push_back(argv[++i]);
+      if ( std::find(PATHS, PATHS+NUM_PATHS, paths.back()) == PATHS+NUM_PATHS )
+        usage(argv[0]);
+    }
+    else if ( !strcmp(arg, "--cull") )
+      cull = true;
+    else if ( !strcmp(arg, "--cleanup") )
+      MeshCleanup::setEnabled(true);
+    else if ( !strcmp(arg, "--cleanup-epsilon") && hasValue )
+    {
+      MeshCleanup::setSliverThreshold(atof(argv[++i]));
+      MeshCleanup::setEnabled(true);
+    }
+    else if ( !strcmp(arg, "--cache-dir") && hasValue )
+    {
+      MeshCache::setDirectory(argv[++i]);
+      MeshCache::setEnabled(true);
+    }
+    else if ( !strcmp(arg, "--json") && hasValue )
+      json = argv[++i];
+    else if ( !strcmp(arg, "--trace") && hasValue )
+      trace = argv[++i];
+    else if ( !strcmp(arg, "--golden") && hasValue )
+      golden = argv[++i];
+    else if ( !strcmp(arg, "--update-golden") )
+      updateGolden = true;
+    else if ( !strcmp(arg, "--tolerance") && hasValue )
+      tolerance = std::max(0, atoi(argv[++i]));
+    else if ( !strcmp(arg, "--max-bad") && hasValue )
+      maxBad = std::max(0.0, atof(argv[++i]));
+    else if ( !strcmp(arg, "--baseline") && hasValue )
+      baseline = argv[++i];
+    else if ( !strcmp(arg, "--max-regression") && hasValue )
+      maxRegression = std::max(0.0, atof(argv[++i]));
+    else if ( arg[0] == '-' )
+      usage(argv[0]);
+    else
+      models.push_back(arg);
+  }
+
+  if ( models.empty() )
+  {
+    models.push_back("bunny.obj");
+    models.push_back("dragon.obj");
+    models.push_back("blue_blade/blue_blade.obj");
+    for ( int i=1; i <= 7; i++ )
+    {
+      char name[64];
+      sprintf(name, "blue_blade/blue_blade%02d.obj", i);
+      models.push_back(name);
+    }
+  }
+  if ( sizes.empty() )
+  {
+    sizes.push_back(std::make_pair(320, 240));
+    sizes.push_back(std::make_pair(640, 480));
+    sizes.push_back(std::make_pair(1280, 720));
+  }
+  if ( paths.empty() )
+    paths.assign(PATHS, PATHS+NUM_PATHS);
+  if ( updateGolden && !golden )
+    usage(argv[0]);
+
+  ThreadPool pool(threads);
+  Trace::setThreadName("main");
+  if ( trace )
+    Trace::start();
+
+  Renderer renderer(&pool);
+  renderer.setBackfaceCulling(cull);
+  std::vector<Result> results;
+  int goldenImages = 0;
+  int goldenFailures = 0;
+
+  printf("zbuffer_bench: %lu threads, %d frames per path, %d warmup\n",
+         (unsigned long)pool.numThreads(), frames, warmup);
+
+  for ( size_t m=0; m < models.size(); m++ )
+  {
+    Clock::time_point start = Clock::now();
+    Model model(models[m].c_str(), &pool);
+    double loadMs = elapsed_ms(start);
+
+    for ( size_t s=0; s < sizes.size(); s++ )
+    {
+      FrameBuffer fb(sizes[s].first, sizes[s].second);
+
+      for ( size_t p=0; p < paths.size(); p++ )
+      {
+        for ( int i=0; i < warmup; i++ )
+          renderer.render(model, camera_on_path(paths[p], i, frames), fb);
+
+        std::vector<double> ms;
+        size_t fragments = 0;
+        FrameTimings stages;
+        RenderStats stats;
+        uint64_t checksum = 14695981039346656037ULL;   // FNV-1a over all frames
+        for ( int i=0; i < frames; i++ )
+        {
+          start = Clock::now();
+          renderer.render(model, camera_on_path(paths[p], i, frames), fb);
+          ms.push_back(elapsed_ms(start));
+          fragments += renderer.fragments();
+          stages += renderer.timings();
+          stats += renderer.stats();
+
+          const uint32_t *pixels = fb.pixels();
+          for ( size_t k=0; k < size_t(fb.width())*fb.height(); k++ )
+            checksum = (checksum ^ pixels[k]) * 1099511628211ULL;
+
+          if ( golden && is_golden_frame(i, frames) )
+          {
+            std::string file = golden_file(golden, models[m], paths[p], fb.width(), fb.height(), i);
+            goldenImages++;
+            if ( updateGolden )
+            {
+              ASSERT_MSG(ImageIO::savePPM(file.c_str(), fb), "cannot write %s", file.c_str());
+              continue;
+            }
+            FrameBuffer reference;
+            long bad = ImageIO::loadPPM(file.c_str(), reference)
+                     ? count_bad_pixels(fb, reference, tolerance) : -1;
+            if ( bad < 0 || bad > maxBad * fb.width() * fb.height() )
+            {
+              goldenFailures++;
+              if ( bad < 0 )
+                printf("FAIL golden %s: missing or wrong size\n", file.c_str());
+              else
+                printf("FAIL golden %s: %ld pixels differ by more than %d\n", file.c_str(), bad, tolerance);
+              std::string actual = file.substr(0, file.size()-4) + ".actual.ppm";
+              ImageIO::savePPM(actual.c_str(), fb);
+            }
+          }
+        }
+
+        Result r;
+        r.model = models[m];
+        r.triangles = model.numTriangles();
+        r.loadMs = loadMs;
+        r.width = fb.width();
+        r.height = fb.height();
+        r.path = paths[p];
+        r.frames = frames;
+        double total = 0.0;
+        for ( size_t i=0; i < ms.size(); i++ )
+          total += ms[i];
+        std::sort(ms.begin(), ms.end());
+        r.mean = total / ms.size();
+        r.p50 = percentile(ms, 0.50);
+        r.p95 = percentile(ms, 0.95);
+        r.p99 = percentile(ms, 0.99);
+        r.min = ms.front();
+        r.max = ms.back();
+        r.trianglesPerSec = r.triangles * double(frames) / (total * 1e-3);
+        r.fragmentsPerSec = fragments / (total * 1e-3);
+        r.stages = stages / frames;
+        r.stats = stats;
+        r.checksum = checksum;
+        results.push_back(r);
+
+        printf("%-28s %8lu tris %5dx%-5d %-6s  p50 %8.2f  p95 %8.2f  p99 %8.2f ms"
+               "  %8.2f Mtri/s  %8.2f Mfrag/s  %016llx\n",
+               r.model.c_str(), (unsigned long)r.triangles, r.width, r.height, r.path.c_str(),
+               r.p50, r.p95, r.p99, r.trianglesPerSec*1e-6, r.fragmentsPerSec*1e-6,
+               (unsigned long long)r.checksum);
+        printf("    %s\n", r.stages.toString().c_str());
+        printf("    %s\n", r.stats.toString().c_str());
+        fflush(stdout);
+      }
+    }
+  }
+
+  if ( json )
+  {
+    FILE *fp = fopen(json, "w");
+    ASSERT_MSG(fp, "cannot write %s", json);
+    fprintf(fp, "{\n  \"threads\": %lu,\n  \"frames\": %d,\n  \"warmup\": %d,\n"
+                "  \"backface_culling\": %s,\n  \"results\": [\n",
+            (unsigned long)pool.numThreads(), frames, warmup, cull ? "true" : "false");
+    for ( size_t i=0; i < results.size(); i++ )
+    {
+      const Result &r = results[i];
+      fprintf(fp, "    {\"model\": \"%s\", \"triangles\": %lu, \"load_ms\": %.3f, "
+                  "\"width\": %d, \"height\": %d, \"path\": \"%s\", \"frames\": %d, "
+                  "\"ms\": {\"mean\": %.3f, \"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, "
+                  "\"min\": %.3f, \"max\": %.3f}, "
+                  "\"triangles_per_s\": %.0f, \"fragments_per_s\": %.0f, \"stages_ms\": {",
+              r.model.c_str(), (unsigned long)r.triangles, r.loadMs,
+              r.width, r.height, r.path.c_str(), r.frames,
+              r.mean, r.p50, r.p95, r.p99, r.min, r.max,
+              r.trianglesPerSec, r.fragmentsPerSec);
+      for ( int k=0; k < FrameTimings::NUM_STAGES; k++ )
+        fprintf(fp, "\"%s\": %.3f, ", FrameTimings::name(FrameTimings::Stage(k)), r.stages.ms[k]);
+      fprintf(fp, "\"wall\": %.3f}, ", r.stages.wallMs);
+      const RenderStats &st = r.stats;
+      fprintf(fp, "\"stats\": {\"triangles_submitted\": %llu, \"triangles_frustum_culled\": %llu, "
+                  "\"triangles_backface_culled\": %llu, \"triangles_rasterized\": %llu, "
+                  "\"fragments\": %llu, \"depth_passed\": %llu, \"depth_failed\": %llu, "
+                  "\"shaded\": %llu, \"depth_complexity_avg\": %.3f, \"depth_complexity_max\": %u}, ",
+              (unsigned long long)st.trianglesSubmitted, (unsigned long long)st.trianglesFrustumCulled,
+              (unsigned long long)st.trianglesBackfaceCulled, (unsigned long long)st.trianglesRasterized,
+              (unsigned long long)st.fragments, (unsigned long long)st.depthPassed,
+              (unsigned long long)st.depthFailed, (unsigned long long)st.shaded,
+              st.averageDepthComplexity(), st.maxDepthComplexity);
+      fprintf(fp, "\"checksum\": \"%016llx\"}%s\n",
+              (unsigned long long)r.checksum, (i+1 < results.size()) ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+    fclose(fp);
+  }
+
+  if ( trace )
+  {
+    Trace::stop();
+    ASSERT_MSG(Trace::write(trace), "cannot write %s", trace);
+  }
+
+  bool failed = false;
+  if ( golden )
+  {
+    printf("golden: %d images %s %s", goldenImages, updateGolden ? "written to" : "compared against", golden);
+    if ( !updateGolden )
+      printf(", %d failed", goldenFailures);
+    printf("\n");
+    failed |= (goldenFailures > 0);
+  }
+
+  if ( baseline )
+  {
+    int baselineThreads;
+    std::vector<Baseline> runs = load_baseline(baseline, baselineThreads);
+    if ( baselineThreads != int(pool.numThreads()) )
+      WARN("baseline %s was measured with %d threads, this run uses %lu",
+           baseline, baselineThreads, (unsigned long)pool.numThreads());
+    int compared = 0, regressions = 0;
+    for ( size_t i=0; i < results.size(); i++ )
+    {
+      const Result &r = results[i];
+      size_t k = 0;
+      for ( ; k < runs.size(); k++ )
+      {
+        const Baseline &b = runs[k];
+        if ( b.model != r.model || b.path != r.path || b.width != r.width || b.height != r.height )
+          continue;
+        compared++;
+        double change = 100.0 * (r.p50 - b.p50) / b.p50;
+        if ( change > maxRegression )
+        {
+          regressions++;
+          printf("FAIL perf %s %dx%d %s: p50 %.2f ms vs %.2f ms baseline (%+.1f%%)\n",
+                 r.model.c_str(), r.width, r.height, r.path.c_str(), r.p50, b.p50, change);
+        }
+        break;
+      }
+      if ( k == runs.size() )
+        printf("FAIL perf %s %dx%d %s: not in the baseline\n",
+               r.model.c_str(), r.width, r.height, r.path.c_str());
+    }
+    printf("baseline: %d of %lu runs compared against %s, %d slower than %.1f%%\n",
+           compared, (unsigned long)results.size(), baseline, regressions, maxRegression);
+    // a run without a baseline proves nothing, it fails like a regression
+    failed |= (regressions > 0 || compared < int(results.size()));
+  }
+
+  return failed ? EXIT_FAILURE : 0;
+}
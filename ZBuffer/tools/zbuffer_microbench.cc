@@ -0,0 +1,303 @@
+// Microbenchmarks of the individual rendering and loading kernels.
+//
+// Every benchmark runs a fixed, seeded workload several times and reports
+// the minimum and median cost per element in nanoseconds and in time stamp
+// counter cycles, so kernel-level changes can be compared without the
+// scheduling and painting noise of the full pipeline.
+//
+// Usage: zbuffer_microbench [options] [model.obj ...]
+//   --reps N       timed repetitions per benchmark (default 10)
+//   --cpu N        pin the benchmark and its one worker thread to logical
+//                  CPU N; unpinned, the parallel kernels use a worker per
+//                  hardware thread
+//   --filter TEXT  only run benchmarks whose name contains TEXT
+//
+// Without model arguments, bunny.obj and dragon.obj are loaded relative to
+// the working directory.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+#include "Model.hpp"
+#include "Camera.hpp"
+#include "ThreadPool.hpp"
+#include "PlyLoader.hpp"
+#include "Logger.hpp"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+#if defined(__linux__)
+#include <sched.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+/// Time stamp counter, 0 where the CPU has none we can read.
+static uint64_t cycles()
+{
+#if defined(_MSC_VER) || defined(__i386__) || defined(__x86_64__)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+static bool pin_to_cpu(int cpu)
+{
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+#elif defined(_WIN32)
+  // threads do not inherit the affinity of their creator, pin them all
+  return SetProcessAffinityMask(GetCurrentProcess(), DWORD_PTR(1) << cpu) != 0;
+#else
+  (void)cpu;
+  return false;
+#endif
+}
+
+// keeps results alive so the compiler cannot drop the measured work
+static volatile uint64_t g_sink;
+
+/// Deterministic pseudo random numbers in [0, 1).
+class Random {
+public:
+  explicit Random(uint32_t seed) : m_state(seed) {}
+  double next()
+  {
+    m_state = m_state * 1664525u + 1013904223u;
+    return (m_state >> 8) * (1.0 / 16777216.0);
+  }
+
+private:
+  uint32_t m_state;
+
+};
+
+/** \brief Triangles of about the given edge length in pixels, placed
+ * inside a w x h image with unit normals facing the camera.
+ */
+static std::vector<Triangle> make_triangles(size_t n, double edgePixels, int w, int h, uint32_t seed)
+{
+  Random random(seed);
+  std::vector<Triangle> triangles(n);
+  const double ex = 2.0 * edgePixels / w;
+  const double ey = 2.0 * edgePixels / h;
+  for ( size_t i=0; i < n; i++ )
+  {
+    Triangle &t = triangles[i];
+    const double x = -1.0 + (2.0 - ex) * random.next();
+    const double y = -1.0 + (2.0 - ey) * random.next();
+    t.vertices[0] = EigenTypes::Vector3(x, y, random.next());
+    t.vertices[1] = EigenTypes::Vector3(x + ex, y + ey * random.next(), random.next());
+    t.vertices[2] = EigenTypes::Vector3(x + ex * random.next(), y + ey, random.next());
+    for ( int k=0; k < 3; k++ )
+      t.normals[k] = EigenTypes::Vector3(random.next() - 0.5, random.next() - 0.5, 1.0).normalized();
+  }
+  return triangles;
+}
+
+class MicroBench {
+public:
+  MicroBench(int reps, const std::string &filter)
+    : m_reps(reps), m_filter(filter)
+  {
+    printf("%-32s %10s %12s %12s %12s %12s\n", "benchmark", "elements",
+           "min ns/el", "med ns/el", "min cyc/el", "med cyc/el");
+  }
+
+  /** \brief Time fn, which processes elements (> 0) units of work, once
+   * untimed and then reps times.
+   */
+  void run(const std::string &name, size_t elements, const std::function<void()> &fn)
+  {
+    if ( !m_filter.empty() && name.find(m_filter) == std::string::npos )
+      return;
+    fn();
+    std::vector<double> ns;
+    std::vector<double> cyc;
+    for ( int r=0; r < m_reps; r++ )
+    {
+      Clock::time_point start = Clock::now();
+      uint64_t c0 = cycles();
+      fn();
+      uint64_t c1 = cycles();
+      ns.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count() / elements);
+      cyc.push_back(double(c1 - c0) / elements);
+    }
+    std::sort(ns.begin(), ns.end());
+    std::sort(cyc.begin(), cyc.end());
+    printf("%-32s %10lu %12.2f %12.2f %12.2f %12.2f\n", name.c_str(), (unsigned long)elements,
+           ns.front(), ns[ns.size()/2], cyc.front(), cyc[cyc.size()/2]);
+    fflush(stdout);
+  }
+
+private:
+  int m_reps;
+  std::string m_filter;
+
+};
+
+static void usage(const char *argv0)
+{
+  fprintf(stderr, "usage: %s [--reps N] [--cpu N] [--filter TEXT] [model.obj ...]\n", argv0);
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+  std::vector<std::string> models;
+  int reps = 10;
+  int cpu = -1;
+  std::string filter;
+
+  for ( int i=1; i < argc; i++ )
+  {
+    const char *arg = argv[i];
+    bool hasValue = (i+1 < argc);
+    if ( !strcmp(arg, "--reps") && hasValue )
+      reps = std::max(1, atoi(argv[++i]));
+    else if ( !strcmp(arg, "--cpu") && hasValue )
+      cpu = atoi(argv[++i]);
+    else if ( !strcmp(arg, "--filter") && hasValue )
+      filter = argv[++i];
+    else if ( arg[0] == '-' )
+      usage(argv[0]);
+    else
+      models.push_back(arg);
+  }
+  if ( models.empty() )
+  {
+    models.push_back("bunny.obj");
+    models.push_back("dragon.obj");
+  }
+
+  bool pinned = false;
+  if ( cpu >= 0 && !(pinned = pin_to_cpu(cpu)) )
+    WARN("cannot pin to CPU %d, running unpinned", cpu);
+  // created after pinning, so the workers share the CPU; a single one
+  // then, the cycle counts assume one core
+  ThreadPool pool(pinned ? 1 : 0);
+  if ( cycles() == 0 )
+    WARN("no time stamp counter on this platform, cycle columns are zero");
+
+  MicroBench bench(reps, filter);
+  const int W = 1280, H = 720;
+  std::vector<Pixel> pixels;
+
+  // Triangle::raster at three triangle sizes, per triangle
+  struct RasterSize { const char *name; size_t count; double edge; };
+  const RasterSize sizes[] = {
+    { "raster small (2 px)", 100000, 2.0 },
+    { "raster medium (16 px)", 20000, 16.0 },
+    { "raster large (128 px)", 500, 128.0 },
+  };
+  for ( size_t s=0; s < sizeof(sizes)/sizeof(sizes[0]); s++ )
+  {
+    const std::vector<Triangle> triangles = make_triangles(sizes[s].count, sizes[s].edge, W, H, 1234u + s);
+    bench.run(sizes[s].name, triangles.size(), [&]() {
+      size_t fragments = 0;
+      for ( size_t i=0; i < triangles.size(); i++ )
+      {
+        pixels.clear();
+        triangles[i].raster(pixels, W, H);
+        fragments += pixels.size();
+      }
+      g_sink = fragments;
+    });
+  }
+
+  // per pixel shading kernels over the fragments of medium triangles
+  {
+    const std::vector<Triangle> triangles = make_triangles(2000, 16.0, W, H, 99u);
+    std::vector<Pixel> fragments;
+    std::vector<uint32_t> owner;
+    for ( size_t i=0; i < triangles.size(); i++ )
+    {
+      triangles[i].raster(fragments, W, H);
+      owner.resize(fragments.size(), uint32_t(i));
+    }
+    bench.run("getDepth", fragments.size(), [&]() {
+      float sum = 0.0f;
+      for ( size_t j=0; j < fragments.size(); j++ )
+        sum += triangles[owner[j]].getDepth(fragments[j]);
+      g_sink = uint64_t(sum);
+    });
+    bench.run("getColor", fragments.size(), [&]() {
+      uint32_t acc = 0;
+      for ( size_t j=0; j < fragments.size(); j++ )
+        acc ^= triangles[owner[j]].getColor(fragments[j]);
+      g_sink = acc;
+    });
+  }
+
+  // per model kernels, per triangle of the model
+  for ( size_t m=0; m < models.size(); m++ )
+  {
+    const std::string &file = models[m];
+
+    Model model(file.c_str(), &pool);
+    const size_t n = model.numTriangles();
+
+    std::vector<tinyobj::shape_t> shapes;
+    if ( PlyLoader::isPly(file.c_str()) )
+    {
+      bench.run("PlyLoader " + file, n, [&]() {
+        std::string err = PlyLoader::load(shapes, file.c_str());
+        ASSERT_MSG(err.empty(), "%s", err.c_str());
+      });
+    }
+    else
+    {
+      bench.run("LoadObj " + file, n, [&]() {
+        shapes.clear();
+        std::string err = tinyobj::LoadObj(shapes, file.c_str());
+        ASSERT_MSG(err.empty(), "%s", err.c_str());
+      });
+      tinyobj::ParallelFor parallelFor = [&pool](size_t count, const std::function<void(size_t, size_t)> &fn) {
+        pool.parallelFor(count, 1, fn);
+      };
+      bench.run("LoadObj parallel " + file, n, [&]() {
+        shapes.clear();
+        std::string err = tinyobj::LoadObj(shapes, file.c_str(), NULL, parallelFor);
+        ASSERT_MSG(err.empty(), "%s", err.c_str());
+      });
+      bench.run("LoadObjStream " + file, n, [&]() {
+        shapes.clear();
+        std::string err = tinyobj::LoadObjStream(shapes, file.c_str());
+        ASSERT_MSG(err.empty(), "%s", err.c_str());
+      });
+    }
+    std::vector<Triangle> triangles;
+    const EigenTypes::Matrix4 transform = Camera().transform(float(W) / H);
+    bench.run("getTriangles " + file, n, [&]() {
+      triangles.clear();
+      model.getTriangles(triangles, transform);
+      g_sink = triangles.size();
+    });
+    bench.run("calculate_normal " + file, n, [&]() {
+      model.recalculateNormals();
+    });
+    bench.run("calculate_normal area " + file, n, [&]() {
+      model.recalculateNormals(Model::AreaWeights);
+    });
+    bench.run("calculate_normal angle " + file, n, [&]() {
+      model.recalculateNormals(Model::AngleWeights);
+    });
+  }
+
+  return 0;
+}
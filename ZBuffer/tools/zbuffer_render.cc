@@ -0,0 +1,244 @@
+// Offline batch renderer.
+//
+// Renders every model of the command line from a list of cameras and
+// writes one image per model and camera, e.g. the thumbnails of a parts
+// library. Several frames render concurrently, each of them on the shared
+// pool as well, so both many small frames and few large ones use all cores.
+//
+// Usage: zbuffer_render [options] model.obj ...
+//   --size WxH        output resolution (default 256x256)
+//   --turntable N     N cameras around the vertical axis (default 36)
+//   --cameras FILE    cameras from FILE instead, one "angleX angleY distance"
+//                     per line as used by ZBWidget; # starts a comment
+//   --out DIR         output directory (default .)
+//   --format png|ppm  image format (default png)
+//   --jobs N          frames rendered concurrently (default one per thread)
+//   --threads N       worker threads (default one per hardware thread)
+//   --cull            enable back-face culling
+//   --cleanup         run MeshCleanup on the models after parsing
+//   --cleanup-epsilon E  sliver threshold of the cleanup, implies --cleanup
+//   --cache-dir DIR   keep MeshCache files in DIR; without it every run parses
+//
+// Images are named <model>_<camera>.<format> after the model file name
+// without directory and extension, e.g. blue_blade05_0007.png. Models whose
+// names clash, like a/mesh.obj and b/mesh.obj, are numbered in command line
+// order: mesh_0007.png and mesh_2_0007.png.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <cstring>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "Model.hpp"
+#include "MeshCleanup.hpp"
+#include "MeshCache.hpp"
+#include "Camera.hpp"
+#include "FrameBuffer.hpp"
+#include "Renderer.hpp"
+#include "ThreadPool.hpp"
+#include "ImageIO.hpp"
+#include "Logger.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+static std::vector<Camera> turntable(int steps)
+{
+  std::vector<Camera> cameras;
+  for ( int i=0; i < steps; i++ )
+    cameras.push_back(Camera(-90.0f, 360.0f * i / steps, 2.0f));
+  return cameras;
+}
+
+static std::vector<Camera> load_cameras(const char *filename)
+{
+  std::vector<Camera> cameras;
+  FILE *fp = fopen(filename, "r");
+  ASSERT_MSG(fp, "cannot read %s", filename);
+  char line[256];
+  for ( int n=1; fgets(line, sizeof(line), fp); n++ )
+  {
+    char *comment = strchr(line, '#');
+    if ( comment )
+      *comment = '\0';
+    float angleX, angleY, distance;
+    char rest;
+    int fields = sscanf(line, " %f %f %f %c", &angleX, &angleY, &distance, &rest);
+    if ( fields == 3 )
+      cameras.push_back(Camera(angleX, angleY, distance));
+    else if ( fields != EOF )
+      WARN("%s:%d: expected \"angleX angleY distance\", line skipped", filename, n);
+  }
+  fclose(fp);
+  return cameras;
+}
+
+static std::string lower_case(std::string s)
+{
+  for ( size_t i=0; i < s.size(); i++ )
+    s[i] = char(tolower((unsigned char)s[i]));
+  return s;
+}
+
+/// File name without directory and extension.
+static std::string base_name(const std::string &path)
+{
+  size_t slash = path.find_last_of("/\\");
+  std::string name = (slash == std::string::npos) ? path : path.substr(slash+1);
+  size_t dot = name.rfind('.');
+  return (dot == std::string::npos || dot == 0) ? name : name.substr(0, dot);
+}
+
+/// Image name stem of every model, base_name() made unique, ignoring case.
+static std::vector<std::string> output_names(const std::vector<std::string> &models)
+{
+  std::vector<std::string> names;
+  std::set<std::string> used;
+  for ( size_t i=0; i < models.size(); i++ )
+  {
+    const std::string base = base_name(models[i]);
+    std::string name = base;
+    for ( int n=2; !used.insert(lower_case(name)).second; n++ )
+    {
+      char suffix[16];
+      sprintf(suffix, "_%d", n);
+      name = base + suffix;
+    }
+    if ( name != base )
+      WARN("%s: image name %s is taken by an earlier model, using %s", models[i].c_str(),
+           base.c_str(), name.c_str());
+    names.push_back(name);
+  }
+  return names;
+}
+
+static void usage(const char *argv0)
+{
+  fprintf(stderr, "usage: %s [--size WxH] [--turntable N | --cameras FILE] [--out DIR]\n"
+                  "       [--format png|ppm] [--jobs N] [--threads N] [--cull] [--cleanup]\n"
+                  "       [--cleanup-epsilon E] [--cache-dir DIR] model.obj ...\n", argv0);
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+  std::vector<std::string> models;
+  int width = 256, height = 256;
+  int steps = 36;
+  const char *cameraFile = 0;
+  std::string outDir = ".";
+  std::string format = "png";
+  int jobs = 0;
+  int threads = 0;
+  bool cull = false;
+
+  for ( int i=1; i < argc; i++ )
+  {
+    const char *arg = argv[i];
+    bool hasValue = (i+1 < argc);
+    if ( !strcmp(arg, "--size") && hasValue )
+    {
+      if ( sscanf(argv[++i], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0 )
+        usage(argv[0]);
+    }
+    else if ( !strcmp(arg, "--turntable") && hasValue )
+      steps = std::max(1, atoi(argv[++i]));
+    else if ( !strcmp(arg, "--cameras") && hasValue )
+      cameraFile = argv[++i];
+    else if ( !strcmp(arg, "--out") && hasValue )
+      outDir = argv[++i];
+    else if ( !strcmp(arg, "--format") && hasValue )
+    {
+      format = argv[++i];
+      if ( format != "png" && format != "ppm" )
+        usage(argv[0]);
+    }
+    else if ( !strcmp(arg, "--jobs") && hasValue )
+      jobs = std::max(1, atoi(argv[++i]));
+    else if ( !strcmp(arg, "--threads") && hasValue )
+      threads = std::max(1, atoi(argv[++i]));
+    else if ( !strcmp(arg, "--cull") )
+      cull = true;
+    else if ( !strcmp(arg, "--cleanup") )
+      MeshCleanup::setEnabled(true);
+    else if ( !strcmp(arg, "--cleanup-epsilon") && hasValue )
+    {
+      MeshCleanup::setSliverThreshold(atof(argv[++i]));
+      MeshCleanup::setEnabled(true);
+    }
+    else if ( !strcmp(arg, "--cache-dir") && hasValue )
+    {
+      MeshCache::setDirectory(argv[++i]);
+      MeshCache::setEnabled(true);
+    }
+    else if ( arg[0] == '-' )
+      usage(argv[0]);
+    else
+      models.push_back(arg);
+  }
+  if ( models.empty() )
+    usage(argv[0]);
+
+  const std::vector<std::string> names = output_names(models);
+  const std::vector<Camera> cameras = cameraFile ? load_cameras(cameraFile) : turntable(steps);
+  ASSERT_MSG(!cameras.empty(), "no cameras in %s", cameraFile);
+
+  ThreadPool pool(threads);
+  if ( jobs == 0 )
+    jobs = int(pool.numThreads());
+
+  Clock::time_point start = Clock::now();
+  std::atomic<size_t> written(0);
+  std::atomic<size_t> failed(0);
+
+  // Models are processed in groups of `jobs`, so even one image per model
+  // keeps all jobs busy while only a group is held in memory.
+  for ( size_t first=0; first < models.size(); first += jobs )
+  {
+    const size_t count = std::min(models.size() - first, size_t(jobs));
+    std::vector<std::unique_ptr<Model> > group(count);
+    pool.parallelFor(count, 1, [&](size_t begin, size_t end) {
+      for ( size_t m=begin; m < end; m++ )
+        group[m].reset(new Model(models[first+m].c_str(), &pool));
+    });
+
+    const size_t frames = count * cameras.size();
+    std::atomic<size_t> next(0);
+    pool.parallelFor(std::min(frames, size_t(jobs)), 1, [&](size_t, size_t) {
+      // one renderer and frame buffer per job, reused for all its frames
+      Renderer renderer(&pool);
+      renderer.setBackfaceCulling(cull);
+      FrameBuffer fb(width, height);
+      for ( size_t k; (k = next++) < frames; )
+      {
+        const size_t m = k / cameras.size();
+        const size_t c = k % cameras.size();
+        renderer.render(*group[m], cameras[c], fb);
+
+        char suffix[32];
+        sprintf(suffix, "_%04lu.", (unsigned long)c);
+        std::string file = outDir + "/" + names[first+m] + suffix + format;
+        bool ok = (format == "png") ? ImageIO::savePNG(file.c_str(), fb)
+                                    : ImageIO::savePPM(file.c_str(), fb);
+        if ( ok )
+          written++;
+        else
+        {
+          failed++;
+          WARN("cannot write %s", file.c_str());
+        }
+      }
+    });
+  }
+
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  printf("zbuffer_render: %lu images in %.2f s (%.1f images/s), %lu jobs on %lu threads\n",
+         (unsigned long)written, seconds, written / seconds,
+         (unsigned long)jobs, (unsigned long)pool.numThreads());
+  return failed ? EXIT_FAILURE : 0;
+}
@@ -0,0 +1,20 @@
+SOURCES += \
+  tools/zbuffer_bench.cc
+
+include(zbuffer_core.pri)
+
+OBJECTS_DIR = build/bench/
+
+# headless: no Qt modules, runs on machines without a display
+QT          =
+CONFIG      -= qt app_bundle
+CONFIG      += console
+
+DESTDIR     = ..
+TARGET      = zbuffer_bench
+
+# make check: compare against the references committed in golden/
+unix {
+  check.commands = sh $$PWD/tools/check_bench.sh $$OUT_PWD/$$DESTDIR/$$TARGET
+  QMAKE_EXTRA_TARGETS += check
+}
@@ -0,0 +1,17 @@
+# Include from any project linking the rendering core (zbuffer_core.pro).
+
+INCLUDEPATH += $$PWD/lib/ \
+  $$PWD/src/ \
+  $$PWD/../
+
+DEPENDPATH += $$PWD/lib/ \
+  $$PWD/src/
+
+unix: INCLUDEPATH += /usr/include/eigen3
+
+LIBS += -L$$PWD/build/core/ -lzbcore
+
+win32: PRE_TARGETDEPS += $$PWD/build/core/zbcore.lib
+else:  PRE_TARGETDEPS += $$PWD/build/core/libzbcore.a
+
+CONFIG += c++11 thread
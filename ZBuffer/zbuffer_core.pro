@@ -0,0 +1,51 @@
+# Qt-independent rendering core: model loading, camera, renderer and frame
+# buffer. Linked by the application and the tools through zbuffer_core.pri.
+
+TEMPLATE    = lib
+CONFIG      += staticlib c++11 thread
+CONFIG      -= qt
+QT          =
+
+SOURCES += \
+  lib/tiny_obj_loader.cc \
+  lib/MappedFile.cpp \
+  lib/CLocale.cpp \
+  src/Model.cpp \
+  src/Camera.cpp \
+  src/FrameBuffer.cpp \
+  src/FrameTimings.cpp \
+  src/ImageIO.cpp \
+  src/MeshCache.cpp \
+  src/MeshCleanup.cpp \
+  src/PlyLoader.cpp \
+  src/RenderStats.cpp \
+  src/Renderer.cpp \
+  src/ThreadPool.cpp \
+  src/Trace.cpp
+
+HEADERS += lib/Logger.hpp \
+    lib/MappedFile.hpp \
+    lib/CLocale.hpp \
+    lib/tiny_obj_loader.h \
+        src/Model.hpp \
+        src/Camera.hpp \
+        src/FrameBuffer.hpp \
+        src/FrameTimings.hpp \
+        src/ImageIO.hpp \
+        src/MeshCache.hpp \
+        src/MeshCleanup.hpp \
+        src/PlyLoader.hpp \
+        src/RenderStats.hpp \
+        src/Renderer.hpp \
+        src/ThreadPool.hpp \
+        src/Trace.hpp \
+
+INCLUDEPATH += lib/ \
+  src/ \
+  ../
+
+unix: INCLUDEPATH += /usr/include/eigen3
+
+OBJECTS_DIR = build/core/
+DESTDIR     = build/core/
+TARGET      = zbcore
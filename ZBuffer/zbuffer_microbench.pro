@@ -0,0 +1,14 @@
+SOURCES += \
+  tools/zbuffer_microbench.cc
+
+include(zbuffer_core.pri)
+
+OBJECTS_DIR = build/microbench/
+
+# headless: no Qt modules, runs on machines without a display
+QT          =
+CONFIG      -= qt app_bundle
+CONFIG      += console
+
+DESTDIR     = ..
+TARGET      = zbuffer_microbench
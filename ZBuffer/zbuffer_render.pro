@@ -0,0 +1,14 @@
+SOURCES += \
+  tools/zbuffer_render.cc
+
+include(zbuffer_core.pri)
+
+OBJECTS_DIR = build/render/
+
+# headless: no Qt modules, runs on machines without a display
+QT          =
+CONFIG      -= qt app_bundle
+CONFIG      += console
+
+DESTDIR     = ..
+TARGET      = zbuffer_render
@@ -1,6 +1,16 @@
 CONFIG       += ordered
 TEMPLATE      = subdirs
-SUBDIRS       = ZBuffer
+SUBDIRS       = core ZBuffer bench microbench render
+
+core.file     = ZBuffer/zbuffer_core.pro
+bench.file    = ZBuffer/zbuffer_bench.pro
+microbench.file = ZBuffer/zbuffer_microbench.pro
+render.file   = ZBuffer/zbuffer_render.pro
+
+ZBuffer.depends = core
+bench.depends   = core
+microbench.depends = core
+render.depends  = core
 
 QT_VERSION=$$[QT_VERSION]
 